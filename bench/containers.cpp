@@ -0,0 +1,403 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Microbenchmarks of the core containers, written out as JSON in the shape
+// of Google Benchmark's --benchmark_format=json, so that the results of two
+// builds can be compared with its tools or a few lines of script, e.g.
+//
+//     bench-containers -k 1000000 > before.json
+//
+// -k is the largest key count of the B+ tree and hash map cases, which run
+// at 1e5, 1e6 and 1e7 keys up to it (1e6 by default), and -f runs only the
+// cases whose name contains a string.  The file-backed cases run in a fresh
+// directory under /tmp; "cold" means a working set much larger than the
+// cache of MemoryManager, not an empty page cache.  Progress goes to the
+// standard error.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "BP_tree.h"
+#include "linked_hash_map.h"
+#include "memory.h"
+#include "tile_storage.h"
+#include "vector.h"
+
+namespace {
+
+constexpr long kRecords = 100000; // records of the TileStorage cases
+constexpr long kHotRecords = 256; // fits in the cache of MemoryManager
+
+struct Record {
+    long key;
+    char payload[248];
+};
+
+struct Result {
+    std::string name;
+    long   iterations;
+    double realTime; // nanoseconds per iteration
+    double cpuTime;
+};
+
+Vector<Result> results;
+const char* filter = "";
+volatile long sink; // keeps the values read from being optimized away
+
+double CpuSeconds() {
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec) * 1e-9;
+}
+
+bool Selected(const std::string& name) {
+    return name.find(filter) != std::string::npos;
+}
+
+// Tell whether any case of a group is selected.  The cases of a group build
+// on each other, e.g. a lookup on the keys inserted before, so a group runs
+// all of them or none, and only the selected ones are reported.
+bool AnySelected(std::initializer_list<const char*> cases, const std::string& size) {
+    for (auto name : cases) {
+        if (Selected(name + size)) return true;
+    }
+    return false;
+}
+
+// Time body(), which does iterations operations, as the case name.
+template<class Body>
+void Measure(const std::string& name, long iterations, Body body) {
+    std::fprintf(stderr, "%s ...\n", name.c_str());
+    double cpu = CpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    body();
+    double real = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+    cpu = (CpuSeconds() - cpu) * 1e9;
+    if (!Selected(name)) return;
+    results.PushBack(Result{name, iterations, real / static_cast<double>(iterations),
+                            cpu / static_cast<double>(iterations)});
+}
+
+// The keys 0 ... count - 1 in a random order, the same every run.
+Vector<long> Shuffled(long count, unsigned long seed) {
+    Vector<long> keys;
+    for (long i = 0; i < count; ++i) keys.PushBack(i);
+    for (long i = count - 1; i > 0; --i) {
+        seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+        long j = static_cast<long>((seed >> 33) % static_cast<unsigned long>(i + 1));
+        std::swap(keys[i], keys[j]);
+    }
+    return keys;
+}
+
+// Start a data file of MemoryManager, which must exist before it is
+// opened, with its rollback log under ROLLBACK.
+void CreateFile(const std::string& name) {
+    std::ofstream(name).close();
+#ifdef ROLLBACK
+    std::ofstream(name + "_log").close();
+#endif
+}
+
+void RemoveFiles(const char* directory) {
+    DIR* entries = opendir(directory);
+    if (entries == nullptr) return;
+    while (dirent* entry = readdir(entries)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..") unlink((std::string(directory) + "/" + name).c_str());
+    }
+    closedir(entries);
+}
+
+#ifdef ROLLBACK
+using Tree = BPTree<long, long>;
+Tree* OpenTree(const std::string& name) {
+    CreateFile(name);
+    return new Tree(name.c_str(), (name + "_log").c_str());
+}
+void Insert(Tree& tree, long key, long value) { tree.Insert(key, value, key); }
+void Erase(Tree& tree, long key) { tree.Erase(key, key); }
+
+using Storage = TileStorage<Record>;
+Storage* OpenStorage(const std::string& name) {
+    CreateFile(name);
+    return new Storage(name.c_str(), (name + "_log").c_str());
+}
+void Modify(Storage& storage, long position, const Record& record) {
+    storage.Modify(position, record, record.key);
+}
+#else
+using Tree = BPTree<long, long>;
+Tree* OpenTree(const std::string& name) {
+    CreateFile(name);
+    return new Tree(name.c_str());
+}
+void Insert(Tree& tree, long key, long value) { tree.Insert(key, value); }
+void Erase(Tree& tree, long key) { tree.Erase(key); }
+
+using Storage = TileStorage<Record>;
+Storage* OpenStorage(const std::string& name) {
+    CreateFile(name);
+    return new Storage(name.c_str());
+}
+void Modify(Storage& storage, long position, const Record& record) {
+    storage.Modify(position, record);
+}
+#endif // ROLLBACK
+
+void TreeCases(long count) {
+    std::string size = "/" + std::to_string(count);
+    if (!AnySelected({"BPTree/Insert", "BPTree/Contains", "BPTree/Erase", "BPTree/MultiFind"},
+                     size)) {
+        return;
+    }
+    Vector<long> keys = Shuffled(count, 1);
+    Tree* tree = OpenTree("tree" + size.substr(1));
+    Measure("BPTree/Insert" + size, count, [&] {
+        for (auto key : keys) Insert(*tree, key, key);
+    });
+    Vector<long> probes = Shuffled(count, 2);
+    Measure("BPTree/Contains" + size, count, [&] {
+        long found = 0, value;
+        for (auto key : probes) found += tree->Contains(key, value);
+        if (found != count) std::fprintf(stderr, "BPTree/Contains found %ld\n", found);
+    });
+    Measure("BPTree/Erase" + size, count, [&] {
+        for (auto key : probes) Erase(*tree, key);
+    });
+    delete tree;
+
+    // Eight values a key, like the trains through a station.
+    constexpr long kValues = 8;
+    long keyCount = count / kValues;
+    Tree* multi = OpenTree("multi" + size.substr(1));
+    for (auto key : Shuffled(keyCount, 3)) {
+        for (long value = 0; value < kValues; ++value) Insert(*multi, key, value);
+    }
+    Vector<long> multiProbes = Shuffled(keyCount, 4);
+    Measure("BPTree/MultiFind" + size, keyCount, [&] {
+        long found = 0;
+        for (auto key : multiProbes) found += multi->MultiFind(key).Size();
+        if (found != count / kValues * kValues) {
+            std::fprintf(stderr, "BPTree/MultiFind found %ld\n", found);
+        }
+    });
+    delete multi;
+}
+
+void StorageCases() {
+    std::string size = "/" + std::to_string(kRecords);
+    if (!AnySelected({"TileStorage/Add", "TileStorage/Get/hot", "TileStorage/Get/cold",
+                      "TileStorage/GetMany/cold", "TileStorage/Modify/hot",
+                      "TileStorage/Modify/cold"}, size)) {
+        return;
+    }
+    Storage* storage = OpenStorage("storage");
+    Vector<long> positions;
+    Record record{};
+    Measure("TileStorage/Add" + size, kRecords, [&] {
+        for (long i = 0; i < kRecords; ++i) {
+            record.key = i;
+            positions.PushBack(storage->Add(record));
+        }
+    });
+    Vector<long> cold = Shuffled(kRecords, 5);
+    Vector<long> hot;
+    for (long i = 0; i < kRecords; ++i) hot.PushBack(cold[i] % kHotRecords);
+    long sum = 0;
+    Measure("TileStorage/Get/hot" + size, kRecords, [&] {
+        for (auto i : hot) sum += storage->Get(positions[i]).key;
+    });
+    Measure("TileStorage/Get/cold" + size, kRecords, [&] {
+        for (auto i : cold) sum += storage->Get(positions[i]).key;
+    });
+    Measure("TileStorage/GetMany/cold" + size, kRecords, [&] {
+        Vector<long> wanted;
+        for (auto i : cold) wanted.PushBack(positions[i]);
+        for (long from = 0; from < wanted.Size();) {
+            Vector<const Record*> values = storage->GetMany(wanted, from);
+            for (auto value : values) sum += value->key;
+            from += values.Size();
+        }
+    });
+    Measure("TileStorage/Modify/hot" + size, kRecords, [&] {
+        for (auto i : hot) {
+            record.key = i;
+            Modify(*storage, positions[i], record);
+        }
+    });
+    Measure("TileStorage/Modify/cold" + size, kRecords, [&] {
+        for (auto i : cold) {
+            record.key = i;
+            Modify(*storage, positions[i], record);
+        }
+    });
+    delete storage;
+    sink = sum;
+}
+
+void HashMapCases(long count) {
+    std::string size = "/" + std::to_string(count);
+    if (!AnySelected({"LinkedHashMap/Insert", "LinkedHashMap/Find/hit", "LinkedHashMap/Find/miss",
+                      "LinkedHashMap/Rehash", "LinkedHashMap/Insert/reserved"}, size)) {
+        return;
+    }
+    Vector<long> keys = Shuffled(count, 6);
+    {
+        LinkedHashMap<long, long> map;
+        Measure("LinkedHashMap/Insert" + size, count, [&] {
+            for (auto key : keys) map.Insert({key, key});
+        });
+        Vector<long> probes = Shuffled(count, 7);
+        Measure("LinkedHashMap/Find/hit" + size, count, [&] {
+            long found = 0;
+            for (auto key : probes) found += map.Contains(key);
+            if (found != count) std::fprintf(stderr, "LinkedHashMap/Find found %ld\n", found);
+        });
+        Measure("LinkedHashMap/Find/miss" + size, count, [&] {
+            long found = 0;
+            for (auto key : probes) found += map.Contains(key + count);
+            if (found != 0) std::fprintf(stderr, "LinkedHashMap/Find found %ld\n", found);
+        });
+        // One rehash moving every key to the next table size, which is what
+        // asking for one bucket more than there are gives.
+        long buckets = map.Stats().buckets;
+        Measure("LinkedHashMap/Rehash" + size, count, [&] {
+            map.ReserveAtLeast(buckets + 1);
+        });
+        if (map.Stats().buckets == buckets) std::fprintf(stderr, "LinkedHashMap/Rehash did not\n");
+    }
+    {
+        LinkedHashMap<long, long> map;
+        Measure("LinkedHashMap/Insert/reserved" + size, count, [&] {
+            map.ReserveAtLeast(count);
+            for (auto key : keys) map.Insert({key, key});
+        });
+    }
+}
+
+void VectorCases(long count) {
+    std::string size = "/" + std::to_string(count);
+    if (!AnySelected({"Vector/PushBack", "Vector/Sort"}, size)) return;
+    Vector<long> keys = Shuffled(count, 8);
+    Vector<long> vector;
+    Measure("Vector/PushBack" + size, count, [&] {
+        for (auto key : keys) vector.PushBack(key);
+    });
+    Measure("Vector/Sort" + size, count, [&] {
+        vector.Sort([](long a, long b) { return a < b; });
+    });
+}
+
+void PrintString(const std::string& string) {
+    std::putchar('"');
+    for (char c : string) {
+        if (c == '"' || c == '\\') std::putchar('\\');
+        std::putchar(c);
+    }
+    std::putchar('"');
+}
+
+void PrintJson() {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    std::string flags;
+#ifdef CONCURRENT
+    flags += " CONCURRENT";
+#endif
+#ifdef IO_URING
+    flags += " IO_URING";
+#endif
+#ifdef __AVX2__
+    flags += " AVX2";
+#endif
+#ifdef ROLLBACK
+    flags += " ROLLBACK";
+#endif
+    std::printf("{\n  \"context\": {\n    \"date\": ");
+    PrintString(date);
+    std::printf(",\n    \"host_name\": ");
+    PrintString(host);
+    std::printf(",\n    \"num_cpus\": %u,\n    \"flags\": ", std::thread::hardware_concurrency());
+    PrintString(flags.empty() ? flags : flags.substr(1));
+    std::printf(",\n    \"compiler\": ");
+    PrintString(__VERSION__);
+    std::printf("\n  },\n  \"benchmarks\": [");
+    for (long i = 0; i < results.Size(); ++i) {
+        const Result& result = results[i];
+        std::printf("%s\n    {\n      \"name\": ", i == 0 ? "" : ",");
+        PrintString(result.name);
+        std::printf(",\n      \"run_type\": \"iteration\",\n      \"iterations\": %ld,\n"
+                    "      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n"
+                    "      \"time_unit\": \"ns\"\n    }",
+                    result.iterations, result.realTime, result.cpuTime);
+    }
+    std::printf("\n  ]\n}\n");
+}
+
+void Usage() {
+    std::fprintf(stderr, "usage: bench-containers [-k max-keys] [-f filter]\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    long maxKeys = 1000000;
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            Usage();
+            return 2;
+        }
+        if (std::strcmp(argv[i], "-k") == 0) {
+            maxKeys = std::atol(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "-f") == 0) {
+            filter = argv[i + 1];
+        } else {
+            Usage();
+            return 2;
+        }
+    }
+
+    char directory[] = "/tmp/bench-containers.XXXXXX";
+    if (mkdtemp(directory) == nullptr || chdir(directory) != 0) {
+        std::perror("bench-containers");
+        return 1;
+    }
+    for (long count = 100000; count <= maxKeys; count *= 10) {
+        TreeCases(count);
+        HashMapCases(count);
+        VectorCases(count);
+    }
+    StorageCases();
+    RemoveFiles(directory);
+    rmdir(directory);
+
+    PrintJson();
+    return 0;
+}
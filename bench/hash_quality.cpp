@@ -0,0 +1,135 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Checks how the hashes spread real keys over the buckets of LinkedHashMap.
+// The station and train names are taken from the add_train commands of an
+// input file, e.g.
+//
+//     bench-hash-quality < data/1.in
+//
+// and made up when there are none.  The exit status is 1 if a map probes
+// more than kMaxProbe nodes per lookup on average, which at the load factor
+// of LinkedHashMap (at most one) only happens with a broken hash.
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "fixed_string.h"
+#include "linked_hash_map.h"
+#include "train.h"
+#include "utility.h"
+#include "vector.h"
+
+namespace {
+
+constexpr double kMaxProbe = 2.0;
+
+// Get the value of a flag of a command line, or an empty view.
+std::string_view Flag(std::string_view line, char flag) {
+    const char key[3] = {'-', flag, ' '};
+    std::size_t position = line.find(std::string_view(key, 3));
+    if (position == std::string_view::npos) return {};
+    line.remove_prefix(position + 3);
+    return line.substr(0, line.find(' '));
+}
+
+void ReadNames(Vector<std::string>& stations, Vector<std::string>& trains) {
+    LinkedHashMap<HashPair, bool, HashPairHash> seen;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line.find(" add_train ") == std::string::npos &&
+            line.compare(0, 10, "add_train ") != 0) {
+            continue;
+        }
+        std::string_view id = Flag(line, 'i');
+        if (!id.empty()) trains.PushBack(std::string(id));
+        std::string_view list = Flag(line, 's');
+        while (!list.empty()) {
+            std::string_view station = list.substr(0, list.find('|'));
+            if (seen.Insert({ToHashPair(station), true}).second) {
+                stations.PushBack(std::string(station));
+            }
+            if (station.size() == list.size()) break;
+            list.remove_prefix(station.size() + 1);
+        }
+    }
+}
+
+// Names that differ only in a few trailing digits, the hard case for a weak
+// hash.
+void MakeNames(Vector<std::string>& stations, Vector<std::string>& trains) {
+    char name[32];
+    for (int i = 0; i < 5000; ++i) {
+        std::snprintf(name, sizeof(name), "Station%05d", i);
+        stations.PushBack(name);
+    }
+    for (int i = 0; i < 10000; ++i) {
+        std::snprintf(name, sizeof(name), "G%d", i);
+        trains.PushBack(name);
+    }
+}
+
+template<class Map, class Key>
+bool Report(const char* name, const Map& map, const Vector<Key>& keys) {
+    auto stats = map.Stats();
+    auto start = std::chrono::steady_clock::now();
+    long found = 0;
+    for (int round = 0; round < 100; ++round) {
+        for (auto& key : keys) found += map.Contains(key);
+    }
+    double nanoseconds = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+    std::printf("%-24s %8zu keys %9ld buckets %9ld used %4ld longest %6.3f probe %7.2f ns/find\n",
+                name, map.Size(), stats.buckets, stats.usedBuckets, stats.longestChain,
+                stats.averageProbe, nanoseconds / 100 / static_cast<double>(found / 100));
+    return stats.averageProbe <= kMaxProbe;
+}
+
+}
+
+int main() {
+    Vector<std::string> stations, trains;
+    ReadNames(stations, trains);
+    if (stations.Empty()) {
+        std::printf("no add_train in the input, using made-up names\n");
+        MakeNames(stations, trains);
+    }
+
+    Vector<HashPair> stationKeys;
+    LinkedHashMap<HashPair, long, HashPairHash> stationMap;
+    for (auto& station : stations) {
+        stationKeys.PushBack(ToHashPair(station));
+        stationMap[stationKeys.Back()] = static_cast<long>(stationKeys.Size());
+    }
+
+    Vector<TrainID> trainKeys;
+    LinkedHashMap<TrainID, long, FixedStringHash1> trainMap;
+    for (auto& train : trains) {
+        trainKeys.PushBack(TrainID(train));
+        trainMap[trainKeys.Back()] = static_cast<long>(trainKeys.Size());
+    }
+
+    bool good = Report("stations (HashPairHash)", stationMap, stationKeys);
+    good = Report("trains (FixedStringHash1)", trainMap, trainKeys) && good;
+    if (!good) {
+        std::printf("FAILED: a map probes more than %.1f nodes per lookup\n", kMaxProbe);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,348 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Replays a workload against the system in server mode and reports how it
+// went, e.g.
+//
+//     bench-replay ./train-ticket-system workload.txt -c 4
+//
+// The binary is started with --server in a fresh directory, so every run
+// starts from empty data files (-d runs it in a given directory instead,
+// created if missing, and keeps the files).  The leading add_user, login, add_train and
+// release_train commands are the setup, sent by one client; the rest of the
+// commands are dealt in turn to the clients (-c, 1 by default), each of
+// which waits for the reply to a command before sending its next one.  An
+// exit command ends the workload.
+//
+// The report gives the throughput of the setup and of the rest, the p50,
+// p99 and largest latency of every command, the peak RSS of the server, and
+// what it read and wrote: read_bytes and write_bytes of /proc/<pid>/io count
+// what went to the disk, rchar and wchar every read and write call,
+// the socket included.  The page cache is not dropped between runs.
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "parameter_table.h"
+#include "vector.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Client {
+    int socket = -1;
+    long line = -1; // the line waiting for its reply, or -1
+    Clock::time_point sent;
+    std::string reply;
+};
+
+// The latencies of every command, in microseconds, by command.
+using Latencies = Vector<double>[kCommandCount + 1];
+
+Command CommandOf(std::string_view line) {
+    if (!line.empty() && line.front() == '[') {
+        auto end = line.find(']');
+        line.remove_prefix(end == std::string_view::npos ? line.size() : end + 1);
+    }
+    while (!line.empty() && line.front() == ' ') line.remove_prefix(1);
+    return ParseCommand(line.substr(0, line.find(' ')));
+}
+
+bool IsSetup(Command command) {
+    return command == Command::addUser || command == Command::login ||
+           command == Command::addTrain || command == Command::releaseTrain;
+}
+
+int Connect(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    for (int attempt = 0; attempt < 500; ++attempt) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) return fd;
+        close(fd);
+        usleep(10000);
+    }
+    return -1;
+}
+
+bool SendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        long sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data.remove_prefix(sent);
+    }
+    return true;
+}
+
+// Send the lines [from, to) through the clients and record the latencies.
+// Returns false if the server went away.
+bool Replay(const Vector<std::string>& lines, long from, long to,
+            Vector<Client>& clients, Latencies& latencies) {
+    long next = from, pending = 0;
+    std::unique_ptr<pollfd[]> fds(new pollfd[clients.Size()]);
+    while (next < to || pending > 0) {
+        for (auto& client : clients) {
+            if (client.line >= 0 || next >= to) continue;
+            client.line = next++;
+            client.reply.clear();
+            client.sent = Clock::now();
+            if (!SendAll(client.socket, lines[client.line] + "\n")) return false;
+            ++pending;
+        }
+        long count = 0;
+        for (auto& client : clients) {
+            if (client.line >= 0) fds[count++] = pollfd{client.socket, POLLIN, 0};
+        }
+        if (poll(fds.get(), count, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        for (auto& client : clients) {
+            if (client.line < 0) continue;
+            char buffer[1 << 16];
+            long got = recv(client.socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (got == 0) return false;
+            if (got < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+                return false;
+            }
+            client.reply.append(buffer, got);
+            // A reply ends with an empty line.
+            std::string_view reply = client.reply;
+            if (reply != "\n" && (reply.size() < 2 || reply.substr(reply.size() - 2) != "\n\n")) {
+                continue;
+            }
+            double micros = std::chrono::duration<double, std::micro>(
+                    Clock::now() - client.sent).count();
+            latencies[static_cast<int>(CommandOf(lines[client.line]))].PushBack(micros);
+            client.line = -1;
+            --pending;
+        }
+    }
+    return true;
+}
+
+double Percentile(const Vector<double>& sorted, double fraction) {
+    long rank = static_cast<long>(std::ceil(fraction * static_cast<double>(sorted.Size())));
+    return sorted[std::max(rank, 1l) - 1];
+}
+
+void Report(const char* name, long count, double seconds) {
+    std::printf("%-10s %8ld commands %9.3f s %12.1f commands/s\n",
+                name, count, seconds, static_cast<double>(count) / seconds);
+}
+
+// The fields of /proc/<pid>/io, read before the process is reaped.
+struct IoCounters {
+    long rchar = 0, wchar = 0, readBytes = 0, writeBytes = 0;
+};
+
+IoCounters ReadIo(pid_t pid) {
+    IoCounters counters;
+    std::ifstream file("/proc/" + std::to_string(pid) + "/io");
+    std::string key;
+    long value;
+    while (file >> key >> value) {
+        if (key == "rchar:") counters.rchar = value;
+        if (key == "wchar:") counters.wchar = value;
+        if (key == "read_bytes:") counters.readBytes = value;
+        if (key == "write_bytes:") counters.writeBytes = value;
+    }
+    return counters;
+}
+
+void RemoveDirectory(const std::string& path) {
+    DIR* directory = opendir(path.c_str());
+    if (directory == nullptr) return;
+    while (dirent* entry = readdir(directory)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..") unlink((path + "/" + name).c_str());
+    }
+    closedir(directory);
+    rmdir(path.c_str());
+}
+
+void Usage() {
+    std::fprintf(stderr, "usage: bench-replay <train-ticket-system> <workload> "
+                         "[-c clients] [-d directory]\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        Usage();
+        return 2;
+    }
+    char binary[PATH_MAX];
+    if (realpath(argv[1], binary) == nullptr) {
+        std::perror(argv[1]);
+        return 2;
+    }
+    long clientCount = 1;
+    std::string directory;
+    for (int i = 3; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            Usage();
+            return 2;
+        }
+        if (std::strcmp(argv[i], "-c") == 0) {
+            clientCount = std::max(std::atol(argv[i + 1]), 1l);
+        } else if (std::strcmp(argv[i], "-d") == 0) {
+            directory = argv[i + 1];
+        } else {
+            Usage();
+            return 2;
+        }
+    }
+
+    Vector<std::string> lines;
+    std::ifstream workload(argv[2]);
+    if (!workload) {
+        std::perror(argv[2]);
+        return 2;
+    }
+    for (std::string line; std::getline(workload, line);) {
+        if (line.empty()) continue;
+        if (CommandOf(line) == Command::exit) break;
+        lines.PushBack(line);
+    }
+    long setup = 0;
+    while (setup < lines.Size() && IsSetup(CommandOf(lines[setup]))) ++setup;
+
+    bool temporary = directory.empty();
+    if (temporary) {
+        char name[] = "/tmp/bench-replay.XXXXXX";
+        if (mkdtemp(name) == nullptr) {
+            std::perror("mkdtemp");
+            return 2;
+        }
+        directory = name;
+    } else {
+        // Made sure of here, as the server could only report a failure to
+        // enter the directory as its own.
+        struct stat status{};
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            std::fprintf(stderr, "cannot create the directory %s: %s\n",
+                         directory.c_str(), std::strerror(errno));
+            return 2;
+        }
+        if (stat(directory.c_str(), &status) != 0 || !S_ISDIR(status.st_mode)) {
+            std::fprintf(stderr, "%s is not a directory\n", directory.c_str());
+            return 2;
+        }
+    }
+    std::string socketPath = directory + "/socket";
+    pid_t server = fork();
+    if (server == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        if (chdir(directory.c_str()) != 0) {
+            std::fprintf(stderr, "cannot enter the directory %s: %s\n",
+                         directory.c_str(), std::strerror(errno));
+            _exit(127);
+        }
+        execl(binary, binary, "--server", socketPath.c_str(), nullptr);
+        std::perror(binary);
+        _exit(127);
+    }
+
+    Vector<Client> clients;
+    clients.Resize(clientCount);
+    bool good = true;
+    for (auto& client : clients) {
+        client.socket = Connect(socketPath);
+        good = good && client.socket >= 0;
+    }
+
+    Latencies latencies;
+    Clock::time_point start = Clock::now();
+    Vector<Client> first;
+    double setupSeconds = 0, runSeconds = 0;
+    if (good) {
+        // The setup goes through the first client alone, in order.
+        first.PushBack(clients[0]);
+        good = Replay(lines, 0, setup, first, latencies);
+        setupSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        start = Clock::now();
+    }
+    if (good) {
+        good = Replay(lines, setup, lines.Size(), clients, latencies);
+        runSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    for (auto& client : clients) {
+        if (client.socket >= 0) close(client.socket);
+    }
+
+    // Stop the server, and read its counters once it has written its data
+    // back but before it is reaped.
+    kill(server, SIGTERM);
+    siginfo_t info;
+    waitid(P_PID, server, &info, WEXITED | WNOWAIT);
+    IoCounters io = ReadIo(server);
+    int status;
+    rusage usage{};
+    wait4(server, &status, 0, &usage);
+    if (temporary) RemoveDirectory(directory);
+    if (!good) {
+        std::fprintf(stderr, "the server went away\n");
+        return 1;
+    }
+
+    std::printf("%ld client(s)\n", clientCount);
+    Report("setup", setup, setupSeconds);
+    Report("run", lines.Size() - setup, runSeconds);
+    std::printf("\n%-16s %8s %10s %10s %10s\n", "command", "count", "p50 us", "p99 us", "max us");
+    for (int i = 0; i <= kCommandCount; ++i) {
+        Vector<double>& times = latencies[i];
+        if (times.Empty()) continue;
+        times.Sort([](double a, double b) { return a < b; });
+        std::string_view name = i == kCommandCount ? std::string_view("unknown")
+                                                   : CommandName(static_cast<Command>(i));
+        std::printf("%-16.*s %8ld %10.1f %10.1f %10.1f\n", static_cast<int>(name.size()),
+                    name.data(), times.Size(), Percentile(times, 0.5), Percentile(times, 0.99),
+                    times.Back());
+    }
+    std::printf("\npeak RSS     %12ld KiB\n", usage.ru_maxrss);
+    std::printf("disk read    %12ld bytes   written %12ld bytes\n", io.readBytes, io.writeBytes);
+    std::printf("calls read   %12ld bytes   written %12ld bytes\n", io.rchar, io.wchar);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
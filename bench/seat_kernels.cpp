@@ -0,0 +1,197 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// A microbenchmark of the seat kernels against the plain loops they
+// replaced.  It is not a test; run it by hand, e.g. once built with and once
+// without -DNATIVE=1, to compare the kernel sets.  Before timing anything it
+// checks every kernel against its plain loop, and fails if they differ.
+
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "seat_count.h"
+#include "seat_kernels.h"
+
+namespace {
+
+constexpr int kStations = 100;
+constexpr int kQueries  = 1 << 12;
+constexpr int kRounds   = 200;
+constexpr int kRepeats  = 10; // a timing is the best of this many, as the host is noisy
+
+struct Query {
+    int from, to, value;
+};
+
+int LoopMin(const int* data, int from, int to) {
+    int result = data[from];
+    for (int i = from + 1; i < to; ++i) {
+        result = std::min(result, data[i]);
+    }
+    return result;
+}
+
+void LoopAdd(int* data, int from, int to, int value) {
+    for (int i = from; i < to; ++i) {
+        data[i] += value;
+    }
+}
+
+bool LoopAllAtLeast(const int* data, int from, int to, int count) {
+    for (int i = from; i < to; ++i) {
+        if (data[i] < count) return false;
+    }
+    return true;
+}
+
+int LoopFirstBelow(const int* data, int count, int bound) {
+    for (int i = 0; i < count; ++i) {
+        if (data[i] < bound) return i;
+    }
+    return count;
+}
+
+// Run every kernel on every run [from, from + count) of a random array and
+// compare it with the plain loop.  This covers the vector bodies, the tails
+// of every length and the starts that are not aligned.
+bool CheckKernels(std::mt19937& random) {
+    int data[kStations];
+    for (auto& entry : data) entry = static_cast<int>(random() % 200) - 100;
+    for (int from = 0; from < kStations; ++from) {
+        for (int count = 0; from + count <= kStations; ++count) {
+            int least = INT_MAX;
+            for (int i = from; i < from + count; ++i) least = std::min(least, data[i]);
+            if (RangeMin(data + from, count) != least) {
+                std::fprintf(stderr, "RangeMin is wrong on [%d, %d)\n", from, from + count);
+                return false;
+            }
+
+            int bounds[] = {-200, 200, static_cast<int>(random() % 200) - 100};
+            for (int bound : bounds) {
+                if (FirstBelow(data + from, count, bound) != LoopFirstBelow(data + from, count, bound)) {
+                    std::fprintf(stderr, "FirstBelow is wrong on [%d, %d) below %d\n",
+                                 from, from + count, bound);
+                    return false;
+                }
+            }
+
+            // The whole array is compared, so a write outside the run shows too.
+            int value = static_cast<int>(random() % 7) - 3;
+            int added[kStations], looped[kStations];
+            std::memcpy(added, data, sizeof(data));
+            std::memcpy(looped, data, sizeof(data));
+            RangeAdd(added + from, count, value);
+            LoopAdd(looped, from, from + count, value);
+            if (std::memcmp(added, looped, sizeof(data)) != 0) {
+                std::fprintf(stderr, "RangeAdd is wrong on [%d, %d)\n", from, from + count);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template<class Function>
+void Measure(const char* name, Function function) {
+    double best = 0;
+    long sink = 0;
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < kRounds; ++round) {
+            sink += function();
+        }
+        double nanoseconds = std::chrono::duration<double, std::nano>(
+                std::chrono::steady_clock::now() - start).count();
+        if (repeat == 0 || nanoseconds < best) best = nanoseconds;
+    }
+    std::printf("%-28s %8.2f ns/op   (%ld)\n", name, best / kRounds / kQueries, sink);
+}
+
+}
+
+int main() {
+    std::mt19937 random(2022);
+    std::printf("kernels: %s\n", kSeatKernels);
+    if (!CheckKernels(random)) {
+        return 1;
+    }
+    std::printf("every kernel agrees with its loop\n");
+
+    Query queries[kQueries];
+    for (auto& query : queries) {
+        query.from = static_cast<int>(random() % (kStations - 1)) + 1;
+        query.to = query.from + 1 + static_cast<int>(random() % (kStations - query.from));
+        query.value = static_cast<int>(random() % 3) + 1;
+    }
+    int plain[kStations];
+    SeatCount seats;
+    for (int i = 0; i < kStations; ++i) plain[i] = 100000;
+    seats.Reset(kStations, 100000);
+
+    Measure("loop min", [&] {
+        long sum = 0;
+        for (auto& query : queries) sum += LoopMin(plain, query.from, query.to);
+        return sum;
+    });
+    Measure("RangeMin", [&] {
+        long sum = 0;
+        for (auto& query : queries) sum += RangeMin(plain + query.from, query.to - query.from);
+        return sum;
+    });
+    Measure("SeatCount::Min", [&] {
+        long sum = 0;
+        for (auto& query : queries) sum += seats.Min(query.from, query.to);
+        return sum;
+    });
+    Measure("loop all >= n", [&] {
+        long sum = 0;
+        for (auto& query : queries) sum += LoopAllAtLeast(plain, query.from, query.to, query.value);
+        return sum;
+    });
+    Measure("FirstBelow", [&] {
+        long sum = 0;
+        for (auto& query : queries) {
+            int count = query.to - query.from;
+            sum += FirstBelow(plain + query.from, count, query.value) == count;
+        }
+        return sum;
+    });
+    Measure("SeatCount::AllAtLeast", [&] {
+        long sum = 0;
+        for (auto& query : queries) sum += seats.AllAtLeast(query.from, query.to, query.value);
+        return sum;
+    });
+    // Every round subtracts and adds back, so the counters stay put.
+    Measure("loop add", [&] {
+        for (auto& query : queries) LoopAdd(plain, query.from, query.to, -query.value);
+        for (auto& query : queries) LoopAdd(plain, query.from, query.to, query.value);
+        return plain[1];
+    });
+    Measure("RangeAdd", [&] {
+        for (auto& query : queries) RangeAdd(plain + query.from, query.to - query.from, -query.value);
+        for (auto& query : queries) RangeAdd(plain + query.from, query.to - query.from, query.value);
+        return plain[1];
+    });
+    Measure("SeatCount::Add", [&] {
+        for (auto& query : queries) seats.Add(query.from, query.to, -query.value);
+        for (auto& query : queries) seats.Add(query.from, query.to, query.value);
+        return seats.Get(1);
+    });
+    return 0;
+}
@@ -0,0 +1,409 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Writes a synthetic workload for the system to the standard output, e.g.
+//
+//     bench-workload -u 2000 -t 500 -n 100000 -m balanced -s 1 > workload.txt
+//
+// The same arguments always give the same commands.  A setup part adds the
+// users and the trains and releases them; the rest is drawn from a mix of
+// commands, with the trains, the stations and the users picked with a Zipf
+// skew (-z, 1 by default), so that a few hot trains and hub stations take
+// most of the traffic like they do on a real railway.  The output can be
+// piped into train-ticket-system, or replayed with bench-replay.
+//
+// The mixes (-m) are
+//     balanced  queries, purchases and refunds of every kind
+//     query     mostly query_ticket, query_transfer and query_train
+//     buy       mostly buy_ticket and refund_ticket
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "vector.h"
+
+namespace {
+
+// splitmix64, written out so that a seed means the same workload with any
+// standard library.
+class Random {
+public:
+    explicit Random(std::uint64_t seed) : state_(seed) {}
+
+    std::uint64_t Next() {
+        std::uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // A number in [from, to].
+    long Between(long from, long to) {
+        return from + static_cast<long>(Next() % static_cast<std::uint64_t>(to - from + 1));
+    }
+
+    // A number in [0, 1).
+    double Real() {
+        return static_cast<double>(Next() >> 11) * 0x1.0p-53;
+    }
+
+    bool Chance(double probability) {
+        return Real() < probability;
+    }
+
+private:
+    std::uint64_t state_;
+};
+
+// Picks 0 ... count - 1, i with a weight of 1 / (i + 1)^skew.
+class Zipf {
+public:
+    Zipf(long count, double skew) {
+        double sum = 0;
+        for (long i = 0; i < count; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+            cumulative_.PushBack(sum);
+        }
+        for (auto& value : cumulative_) value /= sum;
+    }
+
+    long operator()(Random& random) const {
+        double target = random.Real();
+        long low = 0, high = cumulative_.Size() - 1;
+        while (low < high) {
+            long middle = (low + high) / 2;
+            if (cumulative_[middle] < target) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+private:
+    Vector<double> cumulative_;
+};
+
+enum Kind {
+    kQueryTicket,
+    kQueryTransfer,
+    kBuyTicket,
+    kRefundTicket,
+    kQueryOrder,
+    kQueryProfile,
+    kQueryTrain,
+    kModifyProfile,
+    kLogin,
+    kLogout,
+    kKindCount,
+};
+
+struct Mix {
+    const char* name;
+    int weights[kKindCount];
+};
+
+constexpr Mix kMixes[] = {
+    {"balanced", {25, 5, 30, 5, 10, 8, 7, 3, 4, 3}},
+    {"query",    {50, 10, 8, 2, 5, 8, 15, 0, 1, 1}},
+    {"buy",      {10, 0, 60, 15, 10, 3, 0, 0, 1, 1}},
+};
+
+constexpr const char* kCities[] = {
+    "北京", "上海", "广州", "深圳", "天津", "重庆", "南京", "杭州", "武汉", "成都",
+    "西安", "郑州", "长沙", "沈阳", "济南", "青岛", "大连", "厦门", "福州", "合肥",
+    "南昌", "昆明", "贵阳", "南宁", "太原", "石家庄", "兰州", "银川", "西宁", "乌鲁木齐",
+    "呼和浩特", "哈尔滨", "长春", "苏州", "无锡", "常州", "宁波", "温州", "徐州", "洛阳",
+};
+constexpr const char* kSides[] = {"", "东", "西", "南", "北"};
+
+// June 1st is day 0, as in the sale dates of the system.
+std::string DateName(long day) {
+    static constexpr int kMonthDays[] = {30, 31, 31, 30};
+    int month = 0;
+    while (month < 3 && day >= kMonthDays[month]) day -= kMonthDays[month++];
+    char name[24]; // room for "MM-" and any long, so nothing is cut
+    std::snprintf(name, sizeof(name), "%02d-%02ld", month + 6, day + 1);
+    return name;
+}
+
+struct Train {
+    std::string id;
+    Vector<long> stations;
+    long firstDay, lastDay;
+};
+
+struct User {
+    std::string name;
+    bool loggedIn = false;
+    long orders = 0;
+};
+
+class Generator {
+public:
+    Generator(long users, long trains, double skew, std::uint64_t seed)
+        : random_(seed), userPick_(users, skew), trainPick_(trains, skew) {
+        for (auto city : kCities) {
+            for (auto side : kSides) stationNames_.PushBack(std::string(city) + side);
+        }
+        stationPick_ = new Zipf(stationNames_.Size(), skew);
+        for (long i = 0; i < users; ++i) {
+            users_.PushBack(User{"user" + std::to_string(i)});
+        }
+        for (long i = 0; i < trains; ++i) {
+            trains_.PushBack(MakeTrain(i));
+        }
+    }
+
+    Generator(const Generator&) = delete;
+
+    Generator& operator=(const Generator&) = delete;
+
+    ~Generator() { delete stationPick_; }
+
+    void Setup() {
+        Line("add_user -c root -u root -p root -n 管理员 -m root@example.com -g 10");
+        Line("login -u root -p root");
+        for (auto& user : users_) {
+            Line("add_user -c root -u " + user.name + " -p pw -n 旅客 -m " + user.name +
+                 "@example.com -g " + std::to_string(random_.Between(1, 9)));
+        }
+        for (auto& train : trains_) AddTrain(train);
+        for (auto& train : trains_) Line("release_train -i " + train.id);
+        for (long i = 0; i < users_.Size(); i += 2) Login(users_[i]);
+    }
+
+    void Run(const Mix& mix, long count) {
+        int total = 0;
+        for (int weight : mix.weights) total += weight;
+        for (long i = 0; i < count; ++i) {
+            long pick = random_.Between(0, total - 1);
+            int kind = 0;
+            while (pick >= mix.weights[kind]) pick -= mix.weights[kind++];
+            Command(static_cast<Kind>(kind));
+        }
+        Line("exit");
+    }
+
+    void Write() const {
+        std::fwrite(buffer_.data(), 1, buffer_.size(), stdout);
+    }
+
+private:
+    Train MakeTrain(long index) {
+        Train train;
+        train.id = "G" + std::to_string(index);
+        // Mostly 5 to 30 stops, sometimes a long-distance train of up to 100.
+        long count = random_.Chance(0.1) ? random_.Between(31, 100) : random_.Between(5, 30);
+        count = std::min(count, stationNames_.Size());
+        while (train.stations.Size() < count) {
+            long station = (*stationPick_)(random_);
+            bool seen = false;
+            for (auto other : train.stations) seen = seen || other == station;
+            if (!seen) train.stations.PushBack(station);
+        }
+        train.firstDay = random_.Between(0, 30);
+        train.lastDay = std::min(train.firstDay + random_.Between(20, 60), 91l);
+        return train;
+    }
+
+    void AddTrain(const Train& train) {
+        std::string stations, prices, travel, stopover;
+        for (long i = 0; i < train.stations.Size(); ++i) {
+            if (i > 0) stations += '|';
+            stations += stationNames_[train.stations[i]];
+        }
+        for (long i = 0; i + 1 < train.stations.Size(); ++i) {
+            if (i > 0) prices += '|', travel += '|';
+            prices += std::to_string(random_.Between(10, 500));
+            travel += std::to_string(random_.Between(10, 240));
+        }
+        for (long i = 0; i + 2 < train.stations.Size(); ++i) {
+            if (i > 0) stopover += '|';
+            stopover += std::to_string(random_.Between(1, 15));
+        }
+        if (stopover.empty()) stopover = "_";
+        char start[8];
+        std::snprintf(start, sizeof(start), "%02ld:%02ld",
+                      random_.Between(0, 23), random_.Between(0, 59));
+        Line("add_train -i " + train.id + " -n " + std::to_string(train.stations.Size()) +
+             " -m " + std::to_string(random_.Between(200, 2000)) + " -s " + stations +
+             " -p " + prices + " -x " + start + " -t " + travel + " -o " + stopover +
+             " -d " + DateName(train.firstDay) + "|" + DateName(train.lastDay) +
+             " -y " + static_cast<char>('A' + random_.Between(0, 25)));
+    }
+
+    void Login(User& user) {
+        Line("login -u " + user.name + " -p pw");
+        user.loggedIn = true;
+    }
+
+    // A logged-in user, skewed towards the busy ones, logging one in if
+    // need be.
+    User& Traveller() {
+        User& user = users_[userPick_(random_)];
+        if (!user.loggedIn) Login(user);
+        return user;
+    }
+
+    std::string SaleDate(const Train& train) {
+        return DateName(random_.Between(train.firstDay, train.lastDay));
+    }
+
+    // Two stations of a train in the order it passes them.
+    void Leg(const Train& train, long& from, long& to) {
+        from = random_.Between(0, train.stations.Size() - 2);
+        to = random_.Between(from + 1, train.stations.Size() - 1);
+    }
+
+    void Command(Kind kind) {
+        const Train& train = trains_[trainPick_(random_)];
+        long from, to;
+        Leg(train, from, to);
+        const std::string& fromName = stationNames_[train.stations[from]];
+        const std::string& toName = stationNames_[train.stations[to]];
+        const char* order = random_.Chance(0.5) ? "time" : "cost";
+        switch (kind) {
+            case kQueryTicket:
+                Line("query_ticket -s " + fromName + " -t " + toName + " -d " +
+                     SaleDate(train) + " -p " + order);
+                break;
+            case kQueryTransfer: {
+                const Train& other = trains_[trainPick_(random_)];
+                Line("query_transfer -s " + fromName + " -t " +
+                     stationNames_[other.stations[other.stations.Size() - 1]] + " -d " +
+                     SaleDate(train) + " -p " + order);
+                break;
+            }
+            case kBuyTicket: {
+                User& user = Traveller();
+                Line("buy_ticket -u " + user.name + " -i " + train.id + " -d " + SaleDate(train) +
+                     " -n " + std::to_string(random_.Between(1, 5)) + " -f " + fromName +
+                     " -t " + toName + " -q " + (random_.Chance(0.3) ? "true" : "false"));
+                ++user.orders;
+                break;
+            }
+            case kRefundTicket: {
+                User& user = Traveller();
+                long orders = std::max(user.orders, 1l);
+                Line("refund_ticket -u " + user.name + " -n " +
+                     std::to_string(random_.Between(1, std::min(orders, 3l))));
+                break;
+            }
+            case kQueryOrder:
+                Line("query_order -u " + Traveller().name);
+                break;
+            case kQueryProfile: {
+                User& user = Traveller();
+                Line("query_profile -c " + user.name + " -u " + user.name);
+                break;
+            }
+            case kQueryTrain:
+                Line("query_train -i " + train.id + " -d " + SaleDate(train));
+                break;
+            case kModifyProfile: {
+                User& user = Traveller();
+                Line("modify_profile -c " + user.name + " -u " + user.name + " -m " +
+                     user.name + std::to_string(random_.Between(0, 99)) + "@example.com");
+                break;
+            }
+            case kLogin:
+                Login(users_[userPick_(random_)]);
+                break;
+            case kLogout: {
+                User& user = users_[userPick_(random_)];
+                Line("logout -u " + user.name);
+                user.loggedIn = false;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void Line(const std::string& command) {
+        buffer_ += '[';
+        buffer_ += std::to_string(++timeStamp_);
+        buffer_ += "] ";
+        buffer_ += command;
+        buffer_ += '\n';
+    }
+
+    Random random_;
+    Vector<std::string> stationNames_;
+    Zipf userPick_, trainPick_;
+    Zipf* stationPick_ = nullptr;
+    Vector<User> users_;
+    Vector<Train> trains_;
+    std::string buffer_;
+    long timeStamp_ = 0;
+};
+
+void Usage() {
+    std::fprintf(stderr, "usage: bench-workload [-u users] [-t trains] [-n commands] "
+                         "[-m balanced|query|buy] [-z skew] [-s seed]\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    long users = 1000, trains = 300, commands = 50000;
+    double skew = 1.0;
+    std::uint64_t seed = 1;
+    const Mix* mix = &kMixes[0];
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 == argc || argv[i][0] != '-' || std::strlen(argv[i]) != 2) {
+            Usage();
+            return 2;
+        }
+        const char* value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'u': users = std::atol(value); break;
+            case 't': trains = std::atol(value); break;
+            case 'n': commands = std::atol(value); break;
+            case 'z': skew = std::atof(value); break;
+            case 's': seed = std::strtoull(value, nullptr, 10); break;
+            case 'm':
+                mix = nullptr;
+                for (auto& candidate : kMixes) {
+                    if (std::strcmp(candidate.name, value) == 0) mix = &candidate;
+                }
+                if (mix == nullptr) {
+                    Usage();
+                    return 2;
+                }
+                break;
+            default:
+                Usage();
+                return 2;
+        }
+    }
+    if (users < 1 || trains < 1 || commands < 0) {
+        Usage();
+        return 2;
+    }
+
+    Generator generator(users, trains, skew, seed);
+    generator.Setup();
+    generator.Run(*mix, commands);
+    generator.Write();
+    return 0;
+}
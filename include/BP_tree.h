@@ -19,6 +19,9 @@
 
 #include <iostream>
 #include <functional>
+#ifdef CONCURRENT
+#include <shared_mutex>
+#endif
 
 #include "memory.h"
 #include "vector.h"
@@ -105,19 +108,19 @@ private:
             return ret;
         }
 
-        bool Contains_(const KeyT &key, BPTree* tree) {
+        bool Contains_(const KeyT &key, ValT &found, BPTree* tree) {
             int x = Locate_Single(key, tree);
-            char *to = tree -> memo.ReadNode(child[x], -1);
+            char *to = tree -> ReadNode_(child[x], -1);
             if (reinterpret_cast<Node*>(to) -> isleaf) {
-                return reinterpret_cast<LeafNode*>(to) -> Contains_(key, tree);
+                return reinterpret_cast<LeafNode*>(to) -> Contains_(key, found, tree);
             } else {
-                return reinterpret_cast<NleafNode*>(to) -> Contains_(key, tree);
+                return reinterpret_cast<NleafNode*>(to) -> Contains_(key, found, tree);
             }
         }
 
         Vector<ValT> MultiFind_(const KeyT &key, BPTree* tree) {
             int x = Locate_Multi(key, tree);
-            char *to = tree -> memo.ReadNode(child[x], -1);
+            char *to = tree -> ReadNode_(child[x], -1);
             if (reinterpret_cast<Node*>(to) -> isleaf) {
                 return reinterpret_cast<LeafNode*>(to) -> MultiFind_(key, tree);
             } else {
@@ -125,8 +128,19 @@ private:
             }
         }
 
+        Vector<ValT> RangeFind_(const KeyT &lo, const KeyT &hi, BPTree* tree) {
+            int x = Locate_Multi(lo, tree);
+            char *to = tree -> ReadNode_(child[x], -1);
+            if (reinterpret_cast<Node*>(to) -> isleaf) {
+                return reinterpret_cast<LeafNode*>(to) -> RangeFind_(lo, hi, tree);
+            } else {
+                return reinterpret_cast<NleafNode*>(to) -> RangeFind_(lo, hi, tree);
+            }
+        }
+
         Ptr Split(KeyT &reg, BPTree* tree) {
-            char *tmp = tree -> memo.AddNode();
+            tree -> memo.Stats().Split();
+            char *tmp = tree -> memo.AddNode(this -> pos);
             NleafNode* cur = reinterpret_cast<NleafNode*>(tmp);
             cur -> pos = tree -> memo.Last;
             cur -> isleaf = false;
@@ -195,7 +209,7 @@ private:
 
         void Insert_(const KeyT &key, const ValT &val, BPTree* tree) {
             int x = Locate_Multi(key, tree);
-            char *tmp = tree -> memo.ReadNode(child[x], tree -> timeStamp);
+            char *tmp = tree -> ReadNode_(child[x], tree -> timeStamp);
             Node* to = reinterpret_cast<Node*>(tmp);
             if (to -> isleaf) {
                 LeafNode* cur = reinterpret_cast<LeafNode*>(to);
@@ -232,7 +246,7 @@ private:
 
         bool Erase_(const KeyT &key, BPTree* tree) {
             int x = Locate_Single(key, tree);
-            char *tmp = tree -> memo.ReadNode(child[x], tree -> timeStamp);
+            char *tmp = tree -> ReadNode_(child[x], tree -> timeStamp);
             Node* to = reinterpret_cast<Node*>(tmp);
             if (to -> isleaf) {
                 LeafNode* cur = reinterpret_cast<LeafNode*>(to);
@@ -244,7 +258,7 @@ private:
                 }
                 LeafNode* oth;
                 if (x > 0) {
-                    tmp = tree -> memo.ReadNode(child[x - 1], tree -> timeStamp);
+                    tmp = tree -> ReadNode_(child[x - 1], tree -> timeStamp);
                     oth = reinterpret_cast<LeafNode*>(tmp);
                     if (cur -> siz + oth -> siz <= L) {
                         oth -> Merge(cur, tree);
@@ -257,7 +271,7 @@ private:
                         oth -> LeftBalance(cur, keys[x - 1]);
                     }
                 } else {
-                    tmp = tree -> memo.ReadNode(child[1], tree -> timeStamp);
+                    tmp = tree -> ReadNode_(child[1], tree -> timeStamp);
                     oth = reinterpret_cast<LeafNode*>(tmp);
                     if (cur -> siz + oth -> siz <= L) {
                         cur -> Merge(oth, tree);
@@ -280,7 +294,7 @@ private:
                 }
                 NleafNode* oth;
                 if (x > 0) {
-                    tmp = tree -> memo.ReadNode(child[x - 1], tree -> timeStamp);
+                    tmp = tree -> ReadNode_(child[x - 1], tree -> timeStamp);
                     oth = reinterpret_cast<NleafNode*>(tmp);
                     if (cur -> siz + oth -> siz + 1 < M) {
                         oth -> Merge(cur, keys[x - 1], tree);
@@ -293,7 +307,7 @@ private:
                         oth -> LeftBalance(cur, keys[x - 1]);
                     }
                 } else {
-                    tmp = tree -> memo.ReadNode(child[1], tree -> timeStamp);
+                    tmp = tree -> ReadNode_(child[1], tree -> timeStamp);
                     oth = reinterpret_cast<NleafNode*>(tmp);
                     if (cur -> siz + oth -> siz + 1 < M) {
                         cur -> Merge(oth, keys[0], tree);
@@ -333,10 +347,10 @@ private:
             return ret;
         }
 
-        bool Contains_(const KeyT &key, BPTree* tree) {
+        bool Contains_(const KeyT &key, ValT &found, BPTree* tree) {
             int x = Locate(key, tree);
             if (x < this -> siz && tree -> keyEq(key, keys[x])) {
-                tree -> lastVis = vals[x];
+                found = vals[x];
                 return true;
             } else {
                 return false;
@@ -358,14 +372,36 @@ private:
                 if (cur -> nxt == -1) {
                     return ret;
                 }
-                char* tmp = tree -> memo.ReadNode(cur -> nxt, -1);
+                char* tmp = tree -> ReadNode_(cur -> nxt, -1);
+                cur = reinterpret_cast<LeafNode*>(tmp);
+                x = 0;
+            }
+        }
+
+        Vector<ValT> RangeFind_(const KeyT &lo, const KeyT &hi, BPTree* tree) {
+            int x = Locate(lo, tree);
+            Vector<ValT> ret;
+            LeafNode* cur = this;
+            while (1) {
+                while (x < cur -> siz) {
+                    if (!tree -> keyComp(hi, cur -> keys[x])) {
+                        ret.PushBack(cur -> vals[x++]);
+                    } else {
+                        return ret;
+                    }
+                }
+                if (cur -> nxt == -1) {
+                    return ret;
+                }
+                char* tmp = tree -> ReadNode_(cur -> nxt, -1);
                 cur = reinterpret_cast<LeafNode*>(tmp);
                 x = 0;
             }
         }
 
         Ptr Split(KeyT &reg, BPTree* tree) {
-            char *tmp = tree -> memo.AddNode();
+            tree -> memo.Stats().Split();
+            char *tmp = tree -> memo.AddNode(this -> pos);
             LeafNode* cur = reinterpret_cast<LeafNode*>(tmp);
             cur -> pos = tree -> memo.Last;
             cur -> isleaf = true;
@@ -454,15 +490,21 @@ private:
     static_assert(M >= 2 && sizeof(NleafNode) <= 4096);
     static_assert(L >= 1 && sizeof(LeafNode) <= 4096);
 
-    bool Contains_(const KeyT &key) {
+    // Every node is read through here, so that the visits are counted.
+    char* ReadNode_(Ptr pos, long timeStamp_) {
+        memo.Stats().Visit();
+        return memo.ReadNode(pos, timeStamp_);
+    }
+
+    bool Contains_(const KeyT &key, ValT &found) {
         if (root == -1) {
             return false;
         }
-        char *tmp = memo.ReadNode(root, -1);
+        char *tmp = ReadNode_(root, -1);
         if (reinterpret_cast<Node*>(tmp) -> isleaf) {
-            return reinterpret_cast<LeafNode*>(tmp) -> Contains_(key, this);
+            return reinterpret_cast<LeafNode*>(tmp) -> Contains_(key, found, this);
         } else {
-            return reinterpret_cast<NleafNode*>(tmp) -> Contains_(key, this);
+            return reinterpret_cast<NleafNode*>(tmp) -> Contains_(key, found, this);
         }
     }
 
@@ -470,7 +512,7 @@ private:
         if (root == -1) {
             return Vector<ValT>();
         }
-        char *tmp = memo.ReadNode(root, -1);
+        char *tmp = ReadNode_(root, -1);
         if (reinterpret_cast<Node*>(tmp) -> isleaf) {
             return std::move(reinterpret_cast<LeafNode*>(tmp) -> MultiFind_(key, this));
         } else {
@@ -478,6 +520,18 @@ private:
         }
     }
 
+    Vector<ValT> RangeFind_(const KeyT &lo, const KeyT &hi) {
+        if (root == -1) {
+            return Vector<ValT>();
+        }
+        char *tmp = ReadNode_(root, -1);
+        if (reinterpret_cast<Node*>(tmp) -> isleaf) {
+            return std::move(reinterpret_cast<LeafNode*>(tmp) -> RangeFind_(lo, hi, this));
+        } else {
+            return std::move(reinterpret_cast<NleafNode*>(tmp) -> RangeFind_(lo, hi, this));
+        }
+    }
+
     void Insert_(const KeyT &key, const ValT &val) {
         if (root == -1) {
             char *tmp = memo.AddNode();
@@ -491,14 +545,14 @@ private:
             cur -> nxt = -1;
             return;
         }
-        char *tmp = memo.ReadNode(root, timeStamp);
+        char *tmp = ReadNode_(root, timeStamp);
         if (reinterpret_cast<Node*>(tmp) -> isleaf) {
             LeafNode* rt = reinterpret_cast<LeafNode*>(tmp);
             rt -> Insert_(key, val, this);
             if (rt -> siz <= L) {
                 return;
             }
-            char* tmp2 = memo.AddNode();
+            char* tmp2 = memo.AddNode(root);
             NleafNode* cur = reinterpret_cast<NleafNode*>(tmp2);
             cur -> pos = memo.Last;
             cur -> isleaf = false;
@@ -514,7 +568,7 @@ private:
             if (rt -> siz < M) {
                 return;
             }
-            char* tmp2 = memo.AddNode();
+            char* tmp2 = memo.AddNode(root);
             NleafNode* cur = reinterpret_cast<NleafNode*>(tmp2);
             cur -> pos = memo.Last;
             cur -> isleaf = false;
@@ -531,7 +585,7 @@ private:
         if (root == -1) {
             return false;
         }
-        char* tmp = memo.ReadNode(root, timeStamp);
+        char* tmp = ReadNode_(root, timeStamp);
         Node* rt = reinterpret_cast<Node*>(tmp);
         if (rt -> isleaf) {
             if (!reinterpret_cast<LeafNode*>(tmp) -> Erase_(key, this)) {
@@ -564,7 +618,7 @@ private:
 #ifdef TEST
     void Traverse_() {
         for (Ptr pos = head; pos != -1; ) {
-            char *tmp = memo.ReadNode(pos, -1);
+            char *tmp = ReadNode_(pos, -1);
             LeafNode* p = reinterpret_cast<LeafNode*>(tmp);
             for (int i = 0; i < p -> siz; ++i) {
                 //std::cout << p -> keys[i] << " " << p -> vals[i] << " ";
@@ -605,18 +659,35 @@ public:
         head = -1;
     }
 
+    // Read ahead the nodes used last time, or all of them if whole and they
+    // fit in memory.
+    void WarmUp(bool whole) {
+        memo.WarmUp(whole);
+    }
+
     bool Contains(const KeyT &key) {
-        return Contains_(key);
+        return Contains_(key, lastVis);
     }
 
+    //the value found by the last Contains(key)
     ValT Find() {
         return lastVis;
     }
 
+    //the same as Contains(key) then Find(), but safe for concurrent readers
+    bool Contains(const KeyT &key, ValT &value) {
+        return Contains_(key, value);
+    }
+
     Vector<ValT> MultiFind(const KeyT &key) {
         return std::move(MultiFind_(key));
     }
 
+    //get the values of all keys in [lo, hi], in the order of the keys
+    Vector<ValT> RangeFind(const KeyT &lo, const KeyT &hi) {
+        return std::move(RangeFind_(lo, hi));
+    }
+
     void Insert(const KeyT &key, const ValT &val, long timeStamp_) {
         timeStamp = timeStamp_;
         Ptr pre_root = root, pre_head = head;
@@ -697,6 +768,11 @@ private:
     };
     Ptr root, head;
     ValT lastVis;
+#ifdef CONCURRENT
+    //held shared by the lookups and exclusively by the updates, so that the
+    //purchases and refunds of different trains can share a tree
+    std::shared_mutex treeMutex;
+#endif
 
     class NleafNode : public Node {
     public:
@@ -734,19 +810,19 @@ private:
             return ret;
         }
 
-        bool Contains_(const KeyT &key, BPTree* tree) {
+        bool Contains_(const KeyT &key, ValT &found, BPTree* tree) {
             int x = Locate_Single(key, tree);
-            char *to = tree -> memo.ReadNode(child[x]);
+            char *to = tree -> ReadNode_(child[x]);
             if (reinterpret_cast<Node*>(to) -> isleaf) {
-                return reinterpret_cast<LeafNode*>(to) -> Contains_(key, tree);
+                return reinterpret_cast<LeafNode*>(to) -> Contains_(key, found, tree);
             } else {
-                return reinterpret_cast<NleafNode*>(to) -> Contains_(key, tree);
+                return reinterpret_cast<NleafNode*>(to) -> Contains_(key, found, tree);
             }
         }
 
         Vector<ValT> MultiFind_(const KeyT &key, BPTree* tree) {
             int x = Locate_Multi(key, tree);
-            char *to = tree -> memo.ReadNode(child[x]);
+            char *to = tree -> ReadNode_(child[x]);
             if (reinterpret_cast<Node*>(to) -> isleaf) {
                 return reinterpret_cast<LeafNode*>(to) -> MultiFind_(key, tree);
             } else {
@@ -754,8 +830,19 @@ private:
             }
         }
 
+        Vector<ValT> RangeFind_(const KeyT &lo, const KeyT &hi, BPTree* tree) {
+            int x = Locate_Multi(lo, tree);
+            char *to = tree -> ReadNode_(child[x]);
+            if (reinterpret_cast<Node*>(to) -> isleaf) {
+                return reinterpret_cast<LeafNode*>(to) -> RangeFind_(lo, hi, tree);
+            } else {
+                return reinterpret_cast<NleafNode*>(to) -> RangeFind_(lo, hi, tree);
+            }
+        }
+
         Ptr Split(KeyT &reg, BPTree* tree) {
-            char *tmp = tree -> memo.AddNode();
+            tree -> memo.Stats().Split();
+            char *tmp = tree -> memo.AddNode(this -> pos);
             NleafNode* cur = reinterpret_cast<NleafNode*>(tmp);
             cur -> pos = tree -> memo.Last;
             cur -> isleaf = false;
@@ -824,7 +911,7 @@ private:
 
         void Insert_(const KeyT &key, const ValT &val, BPTree* tree) {
             int x = Locate_Multi(key, tree);
-            char *tmp = tree -> memo.ReadNode(child[x]);
+            char *tmp = tree -> ReadNode_(child[x]);
             Node* to = reinterpret_cast<Node*>(tmp);
             if (to -> isleaf) {
                 LeafNode* cur = reinterpret_cast<LeafNode*>(to);
@@ -861,7 +948,7 @@ private:
 
         bool Erase_(const KeyT &key, BPTree* tree) {
             int x = Locate_Single(key, tree);
-            char *tmp = tree -> memo.ReadNode(child[x]);
+            char *tmp = tree -> ReadNode_(child[x]);
             Node* to = reinterpret_cast<Node*>(tmp);
             if (to -> isleaf) {
                 LeafNode* cur = reinterpret_cast<LeafNode*>(to);
@@ -873,7 +960,7 @@ private:
                 }
                 LeafNode* oth;
                 if (x > 0) {
-                    tmp = tree -> memo.ReadNode(child[x - 1]);
+                    tmp = tree -> ReadNode_(child[x - 1]);
                     oth = reinterpret_cast<LeafNode*>(tmp);
                     if (cur -> siz + oth -> siz <= L) {
                         oth -> Merge(cur, tree);
@@ -886,7 +973,7 @@ private:
                         oth -> LeftBalance(cur, keys[x - 1]);
                     }
                 } else {
-                    tmp = tree -> memo.ReadNode(child[1]);
+                    tmp = tree -> ReadNode_(child[1]);
                     oth = reinterpret_cast<LeafNode*>(tmp);
                     if (cur -> siz + oth -> siz <= L) {
                         cur -> Merge(oth, tree);
@@ -909,7 +996,7 @@ private:
                 }
                 NleafNode* oth;
                 if (x > 0) {
-                    tmp = tree -> memo.ReadNode(child[x - 1]);
+                    tmp = tree -> ReadNode_(child[x - 1]);
                     oth = reinterpret_cast<NleafNode*>(tmp);
                     if (cur -> siz + oth -> siz + 1 < M) {
                         oth -> Merge(cur, keys[x - 1], tree);
@@ -922,7 +1009,7 @@ private:
                         oth -> LeftBalance(cur, keys[x - 1]);
                     }
                 } else {
-                    tmp = tree -> memo.ReadNode(child[1]);
+                    tmp = tree -> ReadNode_(child[1]);
                     oth = reinterpret_cast<NleafNode*>(tmp);
                     if (cur -> siz + oth -> siz + 1 < M) {
                         cur -> Merge(oth, keys[0], tree);
@@ -962,10 +1049,10 @@ private:
             return ret;
         }
 
-        bool Contains_(const KeyT &key, BPTree* tree) {
+        bool Contains_(const KeyT &key, ValT &found, BPTree* tree) {
             int x = Locate(key, tree);
             if (x < this -> siz && tree -> keyEq(key, keys[x])) {
-                tree -> lastVis = vals[x];
+                found = vals[x];
                 return true;
             } else {
                 return false;
@@ -987,14 +1074,36 @@ private:
                 if (cur -> nxt == -1) {
                     return ret;
                 }
-                char* tmp = tree -> memo.ReadNode(cur -> nxt);
+                char* tmp = tree -> ReadNode_(cur -> nxt);
+                cur = reinterpret_cast<LeafNode*>(tmp);
+                x = 0;
+            }
+        }
+
+        Vector<ValT> RangeFind_(const KeyT &lo, const KeyT &hi, BPTree* tree) {
+            int x = Locate(lo, tree);
+            Vector<ValT> ret;
+            LeafNode* cur = this;
+            while (1) {
+                while (x < cur -> siz) {
+                    if (!tree -> keyComp(hi, cur -> keys[x])) {
+                        ret.PushBack(cur -> vals[x++]);
+                    } else {
+                        return ret;
+                    }
+                }
+                if (cur -> nxt == -1) {
+                    return ret;
+                }
+                char* tmp = tree -> ReadNode_(cur -> nxt);
                 cur = reinterpret_cast<LeafNode*>(tmp);
                 x = 0;
             }
         }
 
         Ptr Split(KeyT &reg, BPTree* tree) {
-            char *tmp = tree -> memo.AddNode();
+            tree -> memo.Stats().Split();
+            char *tmp = tree -> memo.AddNode(this -> pos);
             LeafNode* cur = reinterpret_cast<LeafNode*>(tmp);
             cur -> pos = tree -> memo.Last;
             cur -> isleaf = true;
@@ -1083,15 +1192,21 @@ private:
     static_assert(M >= 2 && sizeof(NleafNode) <= 4096);
     static_assert(L >= 1 && sizeof(LeafNode) <= 4096);
 
-    bool Contains_(const KeyT &key) {
+    // Every node is read through here, so that the visits are counted.
+    char* ReadNode_(Ptr pos) {
+        memo.Stats().Visit();
+        return memo.ReadNode(pos);
+    }
+
+    bool Contains_(const KeyT &key, ValT &found) {
         if (root == -1) {
             return false;
         }
-        char *tmp = memo.ReadNode(root);
+        char *tmp = ReadNode_(root);
         if (reinterpret_cast<Node*>(tmp) -> isleaf) {
-            return reinterpret_cast<LeafNode*>(tmp) -> Contains_(key, this);
+            return reinterpret_cast<LeafNode*>(tmp) -> Contains_(key, found, this);
         } else {
-            return reinterpret_cast<NleafNode*>(tmp) -> Contains_(key, this);
+            return reinterpret_cast<NleafNode*>(tmp) -> Contains_(key, found, this);
         }
     }
 
@@ -1099,7 +1214,7 @@ private:
         if (root == -1) {
             return Vector<ValT>();
         }
-        char *tmp = memo.ReadNode(root);
+        char *tmp = ReadNode_(root);
         if (reinterpret_cast<Node*>(tmp) -> isleaf) {
             return std::move(reinterpret_cast<LeafNode*>(tmp) -> MultiFind_(key, this));
         } else {
@@ -1107,6 +1222,18 @@ private:
         }
     }
 
+    Vector<ValT> RangeFind_(const KeyT &lo, const KeyT &hi) {
+        if (root == -1) {
+            return Vector<ValT>();
+        }
+        char *tmp = ReadNode_(root);
+        if (reinterpret_cast<Node*>(tmp) -> isleaf) {
+            return std::move(reinterpret_cast<LeafNode*>(tmp) -> RangeFind_(lo, hi, this));
+        } else {
+            return std::move(reinterpret_cast<NleafNode*>(tmp) -> RangeFind_(lo, hi, this));
+        }
+    }
+
     bool Insert_(const KeyT &key, const ValT &val) {
         if (root == -1) {
             char *tmp = memo.AddNode();
@@ -1120,14 +1247,14 @@ private:
             cur -> nxt = -1;
             return true;
         }
-        char *tmp = memo.ReadNode(root);
+        char *tmp = ReadNode_(root);
         if (reinterpret_cast<Node*>(tmp) -> isleaf) {
             LeafNode* rt = reinterpret_cast<LeafNode*>(tmp);
             rt -> Insert_(key, val, this);
             if (rt -> siz <= L) {
                 return true;
             }
-            char* tmp2 = memo.AddNode();
+            char* tmp2 = memo.AddNode(root);
             NleafNode* cur = reinterpret_cast<NleafNode*>(tmp2);
             cur -> pos = memo.Last;
             cur -> isleaf = false;
@@ -1143,7 +1270,7 @@ private:
             if (rt -> siz < M) {
                 return true;
             }
-            char* tmp2 = memo.AddNode();
+            char* tmp2 = memo.AddNode(root);
             NleafNode* cur = reinterpret_cast<NleafNode*>(tmp2);
             cur -> pos = memo.Last;
             cur -> isleaf = false;
@@ -1161,7 +1288,7 @@ private:
         if (root == -1) {
             return false;
         }
-        char* tmp = memo.ReadNode(root);
+        char* tmp = ReadNode_(root);
         Node* rt = reinterpret_cast<Node*>(tmp);
         if (rt -> isleaf) {
             if (!reinterpret_cast<LeafNode*>(tmp) -> Erase_(key, this)) {
@@ -1186,7 +1313,7 @@ private:
 #ifdef TEST
     void Traverse_() {
         for (Ptr pos = head; pos != -1; ) {
-            char *tmp = memo.ReadNode(pos);
+            char *tmp = ReadNode_(pos);
             LeafNode* p = reinterpret_cast<LeafNode*>(tmp);
             for (int i = 0; i < p -> siz; ++i) {
                 std::cout << p -> keys[i] << " " << p -> vals[i] << " ";
@@ -1225,26 +1352,104 @@ public:
         head = -1;
     }
 
+    // Read ahead the nodes used last time, or all of them if whole and they
+    // fit in memory.
+    void WarmUp(bool whole) {
+        memo.WarmUp(whole);
+    }
+
     bool Contains(const KeyT &key) {
-        return Contains_(key);
+        return Contains_(key, lastVis);
     }
 
+    //the value found by the last Contains(key)
     ValT Find() {
         return lastVis;
     }
 
+    //the same as Contains(key) then Find(), but safe for concurrent readers
+    bool Contains(const KeyT &key, ValT &value) {
+#ifdef CONCURRENT
+        std::shared_lock<std::shared_mutex> guard(treeMutex);
+#endif
+        return Contains_(key, value);
+    }
+
     Vector<ValT> MultiFind(const KeyT &key) {
+#ifdef CONCURRENT
+        std::shared_lock<std::shared_mutex> guard(treeMutex);
+#endif
         return std::move(MultiFind_(key));
     }
 
+    //get the values of all keys in [lo, hi], in the order of the keys
+    Vector<ValT> RangeFind(const KeyT &lo, const KeyT &hi) {
+#ifdef CONCURRENT
+        std::shared_lock<std::shared_mutex> guard(treeMutex);
+#endif
+        return std::move(RangeFind_(lo, hi));
+    }
+
     void Insert(const KeyT &key, const ValT &val) {
+#ifdef CONCURRENT
+        std::unique_lock<std::shared_mutex> guard(treeMutex);
+#endif
         Insert_(key, val);
     }
 
     void Erase(const KeyT &key) {
+#ifdef CONCURRENT
+        std::unique_lock<std::shared_mutex> guard(treeMutex);
+#endif
         Erase_(key);
     }
 
+    //rewrite the file with the leaves in the order of the leaf chain, then
+    //the inner nodes level by level from the root, and no free blocks
+    void Compact() {
+        Vector<Ptr> order;
+        for (Ptr pos = head; pos != -1; ) {
+            order.PushBack(pos);
+            pos = reinterpret_cast<LeafNode*>(ReadNode_(pos)) -> nxt;
+        }
+        long leafCount = order.Size();
+        if (root != -1 && !reinterpret_cast<Node*>(ReadNode_(root)) -> isleaf) {
+            order.PushBack(root);
+            for (long i = leafCount; i < order.Size(); ++i) {
+                Ptr first = reinterpret_cast<NleafNode*>(ReadNode_(order[i])) -> child[0];
+                //the leaves are all on the bottom level, so the rest of the
+                //queue is the last inner level
+                if (reinterpret_cast<Node*>(ReadNode_(first)) -> isleaf) break;
+                NleafNode* cur = reinterpret_cast<NleafNode*>(ReadNode_(order[i]));
+                for (int j = 0; j <= cur -> siz; ++j) {
+                    order.PushBack(cur -> child[j]);
+                }
+            }
+        }
+        head = leafCount == 0 ? -1 : 4096;
+        if (root != -1) {
+            root = root == order[0] ? 4096 : (leafCount + 1) * 4096;
+        }
+        Meta *tmp = reinterpret_cast<Meta*>(memo.GetMeta());
+        tmp -> root = root;
+        tmp -> head = head;
+        memo.Rewrite(order, [](char* block, auto& moved) {
+            Node* node = reinterpret_cast<Node*>(block);
+            node -> pos = moved(node -> pos);
+            if (node -> isleaf) {
+                LeafNode* leaf = reinterpret_cast<LeafNode*>(block);
+                if (leaf -> nxt != -1) {
+                    leaf -> nxt = moved(leaf -> nxt);
+                }
+            } else {
+                NleafNode* inner = reinterpret_cast<NleafNode*>(block);
+                for (int j = 0; j <= inner -> siz; ++j) {
+                    inner -> child[j] = moved(inner -> child[j]);
+                }
+            }
+        });
+    }
+
 #ifdef TEST
     void Traverse() {
         std::cerr << "start traverse" << std::endl;
@@ -0,0 +1,118 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TICKET_SYSTEM_INCLUDE_ASYNC_IO_H
+#define TICKET_SYSTEM_INCLUDE_ASYNC_IO_H
+
+#include "vector.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct iovec;
+
+/**
+ * Reads and writes many blocks of a file in one go.
+ * <br>
+ * Requests that follow one another in the file, one starting where the one
+ * before it in the list ends, are merged into a single vectored transfer,
+ * so a caller that sorts its requests by offset gets runs of neighbouring
+ * blocks in one read or write each.
+ * <br>
+ * Under IO_URING the requests of a call are queued on an io_uring and
+ * submitted with a single system call, so the disk gets all of them at once
+ * and may serve them in any order.  Otherwise, or if the kernel refuses to
+ * set up a ring, they are done one by one with pread and pwrite, in the
+ * order given.  Either way a call only returns when every request of it is
+ * done.
+ * <br>
+ * An engine is not shared between threads; under CONCURRENT its owner calls
+ * it under its own lock.
+ */
+class AsyncIO {
+public:
+    struct Request {
+        long  offset;
+        char* data;
+        long  size;
+    };
+
+    AsyncIO();
+
+    AsyncIO(const AsyncIO&) = delete;
+
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    ~AsyncIO();
+
+    /**
+     * Read every request from the file.  What lies past the end of the file
+     * reads as zero.
+     */
+    void Read(int fileDescriptor, const Vector<Request>& requests);
+
+    void Write(int fileDescriptor, const Vector<Request>& requests);
+
+    /**
+     * Tell whether the requests go through an io_uring.
+     */
+    [[nodiscard]] bool Uring() const { return ring_ >= 0; }
+
+private:
+    /**
+     * Requests next to each other in the file, as one vectored transfer.
+     */
+    struct Run {
+        iovec* vectors;
+        long   count;
+        long   offset;
+        long   size;
+    };
+
+    void Run_(int fileDescriptor, const Vector<Request>& requests, bool write);
+
+#ifdef IO_URING
+    static constexpr unsigned kEntries = 64;
+
+    /**
+     * Submit the runs [from, from + count), at most one ring of them, and
+     * wait for all of them.
+     * @return false if the ring failed, in which case the requests may or
+     *         may not have been done
+     */
+    bool Submit_(int fileDescriptor, const Vector<Run>& runs,
+                 long from, long count, bool write);
+
+    void CloseRing_();
+
+    unsigned  entries_ = 0;
+    void*     sqRing_ = nullptr;
+    void*     cqRing_ = nullptr;
+    long      sqRingSize_ = 0;
+    long      cqRingSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqMask_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned* cqMask_ = nullptr;
+#endif // IO_URING
+    int ring_ = -1;
+};
+
+#endif // TICKET_SYSTEM_INCLUDE_ASYNC_IO_H
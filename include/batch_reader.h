@@ -0,0 +1,68 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TICKET_SYSTEM_INCLUDE_BATCH_READER_H
+#define TICKET_SYSTEM_INCLUDE_BATCH_READER_H
+
+#include <string_view>
+
+/**
+ * A line reader for batch runs, where the whole input is known up front.
+ * <br>
+ * If the input is a regular file it is mapped into memory at once;
+ * otherwise it is read in blocks of <code>kBlockSize</code> bytes.  Lines
+ * are found with <code>memchr</code> and handed out as views into the
+ * mapping or the block, so no line is ever copied.
+ */
+class BatchReader {
+public:
+    static constexpr long kBlockSize = 1 << 20;
+
+    explicit BatchReader(int fileDescriptor);
+
+    BatchReader(const BatchReader&) = delete;
+
+    BatchReader& operator=(const BatchReader&) = delete;
+
+    ~BatchReader();
+
+    /**
+     * Get the next line, without the line break.
+     * <br>
+     * The view is only valid until the next call.
+     * @return false if the input is exhausted
+     */
+    bool NextLine(std::string_view& line);
+
+private:
+    /**
+     * Move the unread bytes to the front of the block and read more after
+     * them, growing the block if a single line does not fit.
+     * @return false if nothing more could be read
+     */
+    bool Fill_();
+
+    int fileDescriptor_;
+    char* mapped_ = nullptr;
+    long mappedSize_ = 0;
+    char* block_ = nullptr;
+    long capacity_ = 0;
+    const char* cursor_ = nullptr; // the first unread byte
+    const char* end_ = nullptr;    // one past the last byte read
+    bool exhausted_ = false;
+};
+
+#endif // TICKET_SYSTEM_INCLUDE_BATCH_READER_H
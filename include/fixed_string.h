@@ -17,9 +17,12 @@
 #ifndef TICKET_SYSTEM_INCLUDE_FIXED_STRING_H
 #define TICKET_SYSTEM_INCLUDE_FIXED_STRING_H
 
+#include <cstring>
 #include <functional>
 #include <ostream>
+#include <string_view>
 
+#include "hash.h"
 #include "utility.h"
 
 template<long size>
@@ -38,9 +41,9 @@ public:
         data_[i] = '\0';
     }
 
-    explicit FixedString(const std::string& str) {
-        int i = 0;
-        while (i < size && str[i] != '\0') {
+    explicit FixedString(std::string_view str) {
+        std::size_t i = 0;
+        while (i < size && i < str.size() && str[i] != '\0') {
             data_[i] = str[i];
             ++i;
         }
@@ -68,9 +71,9 @@ public:
         return *this;
     }
 
-    FixedString& operator=(const std::string& str) {
-        int i = 0;
-        while (i < size && str[i] != '\0') {
+    FixedString& operator=(std::string_view str) {
+        std::size_t i = 0;
+        while (i < size && i < str.size() && str[i] != '\0') {
             data_[i] = str[i];
             ++i;
         }
@@ -82,6 +85,8 @@ public:
 
     const char& operator[](long index) const { return data_[index]; }
 
+    [[nodiscard]] const char* Data() const { return data_; }
+
     bool operator==(const FixedString& rhs) const {
         for (long i = 0; i < size; ++i) {
             if (this->data_[i] != rhs.data_[i]) {
@@ -94,9 +99,9 @@ public:
         return true;
     }
 
-    friend bool operator==(const FixedString& lhs, const std::string& rhs) {
+    friend bool operator==(const FixedString& lhs, std::string_view rhs) {
         if (rhs.size() > size) return false;
-        for (long i = 0; i < rhs.size(); ++i) {
+        for (std::size_t i = 0; i < rhs.size(); ++i) {
             if (lhs.data_[i] != rhs[i]) {
                 return false;
             }
@@ -104,14 +109,12 @@ public:
         return lhs.data_[rhs.size()] == '\0';
     }
 
-    friend bool operator==(const std::string& lhs, const FixedString& rhs) {
-        if (lhs.size() > size) return false;
-        for (long i = 0; i < lhs.size(); ++i) {
-            if (rhs.data_[i] != lhs[i]) {
-                return false;
-            }
-        }
-        return rhs.data_[rhs.size()] == '\0';
+    friend bool operator==(std::string_view lhs, const FixedString& rhs) {
+        return rhs == lhs;
+    }
+
+    friend bool operator!=(const FixedString& lhs, std::string_view rhs) {
+        return !(lhs == rhs);
     }
 
     bool operator<(const FixedString& rhs) const {
@@ -134,6 +137,10 @@ private:
     char data_[size + 1];
 };
 
+/**
+ * The hash of a fixed string, as the first half of its Hash128.  Together
+ * with FixedStringHash2 it gives the same HashPair as ToHashPair.
+ */
 class FixedStringHash1 {
 public:
     FixedStringHash1() = default;
@@ -143,27 +150,17 @@ public:
 
     template<long size>
     std::size_t operator()(const FixedString<size>& string) const {
-        std::size_t hash = 0;
-        for (long i = 0; i < size && string[i] != 0; ++i) {
-            hash = hash * kPrime_;
-            hash = hash + static_cast<unsigned char>(string[i]);
-        }
-        return hash;
+        return Hash128(string.Data(), strnlen(string.Data(), size)).first;
     }
 
-    std::size_t operator()(const std::string& string) const {
-        std::size_t hash = 0;
-        for (char i : string) {
-            hash = hash * kPrime_;
-            hash = hash + static_cast<unsigned char>(i);
-        }
-        return hash;
+    std::size_t operator()(std::string_view string) const {
+        return Hash128(string.data(), string.size()).first;
     }
-
-private:
-    constexpr static std::size_t kPrime_ = 1e9 + 7;
 };
 
+/**
+ * The hash of a fixed string, as the second half of its Hash128.
+ */
 class FixedStringHash2 {
 public:
     FixedStringHash2() = default;
@@ -172,35 +169,23 @@ public:
     ~FixedStringHash2() = default;
 
     template<long size>
-    std::size_t operator()(FixedString<size> string) const {
-        std::size_t hash = 0;
-        for (long i = 0; i < size && string[i] != 0; ++i) {
-            hash = hash * kPrime_;
-            hash = hash + static_cast<unsigned char>(string[i]);
-        }
-        return hash;
+    std::size_t operator()(const FixedString<size>& string) const {
+        return Hash128(string.Data(), strnlen(string.Data(), size)).second;
     }
 
-    std::size_t operator()(const std::string& string) const {
-        std::size_t hash = 0;
-        for (char i : string) {
-            hash = hash * kPrime_;
-            hash = hash + static_cast<unsigned char>(i);
-        }
-        return hash;
+    std::size_t operator()(std::string_view string) const {
+        return Hash128(string.data(), string.size()).second;
     }
-
-private:
-    constexpr static std::size_t kPrime_ = 1e9 + 9;
 };
 
 template<long size>
 HashPair ToHashPair(const FixedString<size>& string) {
-    return HashPair(FixedStringHash1()(string),
-                    FixedStringHash2()(string));
+    return Hash128(string.Data(), strnlen(string.Data(), size));
 }
 
-HashPair ToHashPair(const std::string& string);
+inline HashPair ToHashPair(std::string_view string) {
+    return Hash128(string.data(), string.size());
+}
 
 class Hash {
 public:
@@ -210,7 +195,7 @@ public:
     ~Hash() = default;
 
     std::size_t operator()(const Pair<std::size_t, std::size_t>& pair) const {
-        return pair.first ^ pair.second;
+        return HashPairHash()(pair);
     }
 };
 
@@ -0,0 +1,103 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TICKET_SYSTEM_INCLUDE_FREE_MAP_H
+#define TICKET_SYSTEM_INCLUDE_FREE_MAP_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * The free blocks of a file of <code>MemoryManager</code>, one bit per
+ * block.
+ * <br>
+ * The map lives in a sidecar file named after the data file with a
+ * <code>_free</code> suffix.  It is read when the data file is opened and
+ * written back when it is closed; in between the sidecar is left empty, so
+ * a run that dies before closing leaks its free blocks instead of handing
+ * out live ones the next time.  Files of older builds kept their free
+ * blocks in a list through the blocks themselves, which is not read; such
+ * files are refused by the format version check before the map is loaded.
+ * <br>
+ * A block is taken at or after a hint, so that e.g. a B+ tree node split
+ * lands next to its sibling whenever there is a hole nearby.
+ */
+class FreeMap {
+public:
+    explicit FreeMap(const std::string& fileName);
+
+    FreeMap(const FreeMap&) = delete;
+
+    FreeMap& operator=(const FreeMap&) = delete;
+
+    ~FreeMap();
+
+    /**
+     * Read the map from the sidecar file and empty the sidecar.  It is only
+     * called for a data file that exists and has passed the format check,
+     * so the sidecar of a refused file is left alone and a new file does
+     * not take the free blocks of a removed one.
+     */
+    void Load();
+
+    void Free(long block);
+
+    /**
+     * Mark the blocks [from, to) free.
+     */
+    void FreeRange(long from, long to);
+
+    /**
+     * Take the first free block at or after the hint, or the first free
+     * block at all if there is none after it.
+     * @return the block, or -1 if no block is free
+     */
+    long Take(long hint);
+
+    /**
+     * Forget every free block, e.g. after a rollback has brought some of
+     * them back to life.
+     */
+    void Reset();
+
+    /**
+     * Drop the free blocks at the end of a file of blockCount blocks.  The
+     * first block, the meta block of the file, is always kept.
+     * @return the number of blocks left
+     */
+    long TrimTail(long blockCount);
+
+    /**
+     * Write the map to the sidecar file.
+     */
+    void Save() const;
+
+    [[nodiscard]] long FreeCount() const { return freeCount_; }
+
+    [[nodiscard]] bool IsFree(long block) const { return Test_(block); }
+
+private:
+    [[nodiscard]] bool Test_(long block) const;
+
+    void Grow_(long wordCount);
+
+    std::string sidecar_;
+    std::uint64_t* words_ = nullptr;
+    long wordCount_ = 0;
+    long freeCount_ = 0;
+};
+
+#endif // TICKET_SYSTEM_INCLUDE_FREE_MAP_H
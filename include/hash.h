@@ -0,0 +1,111 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TICKET_SYSTEM_INCLUDE_HASH_H
+#define TICKET_SYSTEM_INCLUDE_HASH_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "utility.h"
+
+/*
+ * A 128-bit string hash in the style of wyhash: the input is read eight
+ * bytes at a time and folded into two lanes with 64 x 64 -> 128-bit
+ * multiplications, so a name of up to 16 bytes costs two multiplications
+ * per lane.  The two halves of the result are what the indexes use as a
+ * HashPair.
+ */
+
+constexpr std::uint64_t kHashSecret[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+    0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull,
+};
+
+// Multiply, and fold the high half of the product into the low half.
+inline std::uint64_t HashMix(std::uint64_t lhs, std::uint64_t rhs) {
+    __uint128_t product = static_cast<__uint128_t>(lhs) * rhs;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+}
+
+inline std::uint64_t HashRead8(const char* data) {
+    std::uint64_t value;
+    memcpy(&value, data, 8);
+    return value;
+}
+
+inline std::uint64_t HashRead4(const char* data) {
+    std::uint32_t value;
+    memcpy(&value, data, 4);
+    return value;
+}
+
+inline HashPair Hash128(const char* data, std::size_t length) {
+    std::uint64_t lane0 = kHashSecret[0] ^ length;
+    std::uint64_t lane1 = kHashSecret[3] ^ length;
+    std::uint64_t word0, word1;
+    while (length > 16) {
+        word0 = HashRead8(data);
+        word1 = HashRead8(data + 8);
+        lane0 = HashMix(word0 ^ kHashSecret[1], word1 ^ lane0);
+        lane1 = HashMix(word1 ^ kHashSecret[2], word0 ^ lane1);
+        data += 16;
+        length -= 16;
+    }
+    // The last 1 to 16 bytes, read as two words that may overlap.
+    if (length >= 8) {
+        word0 = HashRead8(data);
+        word1 = HashRead8(data + length - 8);
+    } else if (length >= 4) {
+        word0 = HashRead4(data);
+        word1 = HashRead4(data + length - 4);
+    } else if (length > 0) {
+        auto bytes = reinterpret_cast<const unsigned char*>(data);
+        word0 = (static_cast<std::uint64_t>(bytes[0]) << 16)
+                | (static_cast<std::uint64_t>(bytes[length >> 1]) << 8)
+                | bytes[length - 1];
+        word1 = 0;
+    } else {
+        word0 = word1 = 0;
+    }
+    lane0 = HashMix(word0 ^ kHashSecret[1], word1 ^ lane0);
+    lane1 = HashMix(word1 ^ kHashSecret[2], word0 ^ lane1);
+    return HashPair(HashMix(lane0 ^ kHashSecret[0], lane1 ^ kHashSecret[1]),
+                    HashMix(lane1 ^ kHashSecret[3], lane0 ^ kHashSecret[2]));
+}
+
+/*
+ * The indexes keep only the hash of a name, so two names with the same hash
+ * would be taken for one.  Built with VERIFY_HASH, every hit of an index is
+ * checked against the name in the record it leads to, and a collision
+ * stops the program; otherwise the check and its condition compile to
+ * nothing.
+ */
+#ifdef VERIFY_HASH
+[[noreturn]] inline void HashCollision(const char* index) {
+    std::fprintf(stderr, "hash collision in %s\n", index);
+    std::abort();
+}
+
+#define VERIFY_HASH_HIT(index, matches) \
+    do { if (!(matches)) HashCollision(index); } while (false)
+#else
+#define VERIFY_HASH_HIT(index, matches) ((void) 0)
+#endif // VERIFY_HASH
+
+#endif // TICKET_SYSTEM_INCLUDE_HASH_H
@@ -20,6 +20,7 @@
 // only for std::equal_to<T> and std::hash<T>
 #include <functional>
 #include <cstddef>
+#include <type_traits>
 
 #include "utility.h"
 #include "exceptions.h"
@@ -655,6 +656,33 @@ public:
 
     [[nodiscard]] SizeT Size() const { return size_; }
     [[nodiscard]] bool Empty() const { return size_ == 0; }
+
+    /**
+     * The shape of the buckets, to judge how well the hash spreads the keys.
+     */
+    struct BucketStats {
+        SizeT buckets = 0;
+        SizeT usedBuckets = 0;   // buckets holding at least one node
+        SizeT longestChain = 0;
+        double averageProbe = 0; // nodes visited by a successful lookup, on average
+    };
+
+    [[nodiscard]] BucketStats Stats() const {
+        BucketStats stats;
+        stats.buckets = bucketSize_;
+        SizeT probes = 0;
+        for (SizeT i = 0; i < bucketSize_; ++i) {
+            SizeT chain = 0;
+            for (Node* node = bucket_[i]; node != nullptr; node = node->next) {
+                ++chain;
+                probes += chain;
+            }
+            if (chain > 0) ++stats.usedBuckets;
+            if (chain > stats.longestChain) stats.longestChain = chain;
+        }
+        if (size_ > 0) stats.averageProbe = static_cast<double>(probes) / static_cast<double>(size_);
+        return stats;
+    }
    
 private:
     /**
@@ -780,6 +808,11 @@ template<class Key,
          class Hash = std::hash<Key>,
          class Equal = std::equal_to<Key>>
 class LinkedHashMap {
+    // A hash returning bool (or anything narrower) still compiles, but leaves
+    // the table with only a couple of used buckets.
+    static_assert(std::is_same_v<std::invoke_result_t<const Hash&, const Key&>, std::size_t>,
+                  "the hash of a LinkedHashMap must return std::size_t");
+
 public:
     /**
      * the internal type of data.
@@ -1088,6 +1121,13 @@ public:
 
     void ReserveAtLeast(SizeT size) { table_.ReserveAtLeast(size); }
 
+    using BucketStats = typename LinkedHashTable<value_type, PairHash, PairEqual>::BucketStats;
+
+    /**
+     * Get the bucket distribution and the probe length of the map.
+     */
+    [[nodiscard]] BucketStats Stats() const { return table_.Stats(); }
+
     /**
      * Finds an element with key equivalent to key.
      * key value of the element to search for.
@@ -20,10 +20,67 @@
 
 #include <fstream>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef CONCURRENT
+#include <mutex>
+#endif
 
+#include "async_io.h"
+#include "free_map.h"
 #include "rollback_manager.h"
+#include "stats.h"
 #include "linked_hash_map.h"
+#include "vector.h"
+
+#ifdef CONCURRENT
+// Set while commands run on several threads.  No block is evicted
+// meanwhile, so a block handed out to one thread stays in place however
+// many others the rest read; the caches shrink back to their limit at the
+// first miss after.
+inline bool sharedAccess = false;
+#else
+constexpr bool sharedAccess = false;
+#endif
+
+// The meta block of every file carries a tag and the version of the format
+// at kFormatOffset, after the 16 bytes its owner keeps there (the root and
+// the first leaf of a B+ tree) and the 8 where older builds kept their free
+// list.  A file written with other record layouts or key hashes is refused
+// at start instead of being read as garbage; bump kFormatVersion whenever
+// what is written to disk changes.  The rollback logs hold copies of the
+// blocks of their file, so they go with its version.
+constexpr long kFormatTag = 0x544b545354414d46; // arbitrary; older builds left these bytes zero
+constexpr long kFormatVersion = 1;
+constexpr int kFormatOffset = 24;
+
+inline void StampFormat(char* meta) {
+    memcpy(meta + kFormatOffset, &kFormatTag, sizeof(long));
+    memcpy(meta + kFormatOffset + sizeof(long), &kFormatVersion, sizeof(long));
+}
+
+// Stop the program if the meta block of a file has no tag or another version.
+// Nothing has been written to the file yet, so it is left as it was.
+inline void CheckFormat(const char* meta, const std::string &fileName) {
+    long tag, version;
+    memcpy(&tag, meta + kFormatOffset, sizeof(long));
+    memcpy(&version, meta + kFormatOffset + sizeof(long), sizeof(long));
+    if (tag == kFormatTag && version == kFormatVersion) {
+        return;
+    }
+    if (tag != kFormatTag) {
+        std::cerr << fileName << " was written by an older build, which kept no format version";
+    } else {
+        std::cerr << fileName << " is in format version " << version
+                  << ", but this build reads version " << kFormatVersion;
+    }
+    std::cerr << ".\nRemove the data files of that build to start afresh." << std::endl;
+    std::exit(1);
+}
 
 #ifdef ROLLBACK
 
@@ -33,8 +90,17 @@ class MemoryManager {
 
 private:
     static constexpr int kLimit = std::max(409600 / kBlockSize, 1);
+    static_assert(kBlockSize >= kFormatOffset + 2 * sizeof(long), "no room for the format version");
+    // At most this many blocks are read ahead at a time, so that none of
+    // them is evicted before it is used.
+    static constexpr int kBatch = std::max(kLimit / 2, 1);
 
     std::fstream file;
+    // The same file for the batched reads and writes of io, which bypass
+    // the buffer of file; file is flushed before each batch.
+    int fd;
+    AsyncIO io;
+    FileStats stats;
     RollBackManager<kBlockSize> rbManager;
 
     char meta[kBlockSize];
@@ -49,22 +115,26 @@ private:
         }
     } *head, *rear;
     LinkedHashMap<Ptr, MemNode*> mp;
+#ifdef CONCURRENT
+    // Taken by the calls made while commands run side by side: AddNode,
+    // DelNode and ReadNode.
+    std::mutex cacheMutex;
+#endif
 
-    struct Trash {
-        Ptr pos;
-        Trash* nxt;
-        Trash(Ptr _pos = -1, Trash* _nxt = nullptr): pos(_pos), nxt(_nxt) {}
-    } *trash_head;
+    std::string fileName;
+    FreeMap freeMap;
 
     void InitMeta(bool &isNew) {
         file.seekp(0, std::ios::end);
         if (file.tellp() == 0) {
             memset(meta, 0, sizeof(meta));
+            StampFormat(meta);
             file.write(meta, kBlockSize);
             isNew = true;
         } else {
             file.seekg(0);
             file.read(meta, kBlockSize);
+            CheckFormat(meta, fileName);
             isNew = false;
         }
     }
@@ -72,20 +142,30 @@ private:
 public:
     MemoryManager(const char* filename, const char* filename_log, bool &isNew) : 
         file(filename, std::ios::in | std::ios::out | std::ios::binary),
-        rbManager(filename_log) {
+        fd(open(filename, O_RDWR | O_CLOEXEC)), stats(filename),
+        rbManager(filename_log), fileName(filename), freeMap(fileName) {
         head = rear = nullptr;
-        trash_head = nullptr;
         InitMeta(isNew);
+        if (!isNew) freeMap.Load();
     }
+    // The tail is not trimmed here: a rollback may still write the freed
+    // blocks at the end back.
     ~MemoryManager() {
+        SaveHot();
         ClearMemory();
         file.close();
+        close(fd);
+        freeMap.Save();
     }
 
     char* GetMeta() {
         return meta;
     }
 
+    FileStats& Stats() {
+        return stats;
+    }
+
     void UpdateMeta(long timeStamp) {
         rbManager.Insert(meta, 0, timeStamp);
     }
@@ -93,21 +173,14 @@ public:
     void ClearMemory() {
         file.seekp(0);
         file.write((char*)&meta, kBlockSize);
+        WriteBack();
         mp.Clear();
         for (MemNode* p = head; p != nullptr;) {
             MemNode* q = p -> nxt;
-            file.seekp(p -> pos);
-            file.write(p -> info, kBlockSize);
             delete p;
             p = q;
         }
         head = rear = nullptr;
-        for (Trash* p = trash_head; p != nullptr; ) {
-            Trash* q = p -> nxt;
-            delete p;
-            p = q;
-        }
-        trash_head = nullptr;
     }
 
     void Clear() {
@@ -120,16 +193,123 @@ public:
         head = rear = nullptr;
     }
 
+    // Write every block in memory back in one batch, in the order of the
+    // file.
+    void WriteBack() {
+        Vector<AsyncIO::Request> writes;
+        for (MemNode* p = head; p != nullptr; p = p -> nxt) {
+            writes.PushBack(AsyncIO::Request{p -> pos, p -> info, kBlockSize});
+        }
+        writes.Sort([](const AsyncIO::Request& a, const AsyncIO::Request& b) {
+            return a.offset < b.offset;
+        });
+        file.flush();
+        io.Write(fd, writes);
+        stats.Write(writes.Size() * kBlockSize);
+    }
+
+    // Read the blocks at positions[from], positions[from + 1] ... that are
+    // not in memory with one batch of reads, up to kBatch positions, e.g.
+    // all the trains a query is about to go through.  Returns the index
+    // after the last position taken, where the caller reads ahead again
+    // once it gets there.
+    long Prefetch(const Vector<Ptr>& positions, long from = 0) {
+#ifdef CONCURRENT
+        std::lock_guard<std::mutex> guard(cacheMutex);
+#endif
+        Vector<AsyncIO::Request> reads;
+        long end = std::min(positions.Size(), from + kBatch);
+        for (long i = from; i < end; ++i) {
+            Ptr pos = positions[i];
+            if (mp.Contains(pos)) continue;
+            MemNode* cur = findMemory();
+            cur -> pos = pos;
+            mp[pos] = cur;
+            reads.PushBack(AsyncIO::Request{pos, cur -> info, kBlockSize});
+            stats.Prefetch(kBlockSize);
+        }
+        if (!reads.Empty()) {
+            reads.Sort([](const AsyncIO::Request& a, const AsyncIO::Request& b) {
+                return a.offset < b.offset;
+            });
+            file.flush(); // the blocks evicted above
+            io.Read(fd, reads);
+        }
+        return end;
+    }
+
+    // Write the positions of the blocks in memory, the most recently used
+    // first, to the sidecar named after the file with a _hot suffix, so that
+    // the next run can read them ahead.
+    void SaveHot() {
+        std::ofstream out(fileName + "_hot", std::ios::binary | std::ios::trunc);
+        long count = 0;
+        for (MemNode* p = head; p != nullptr && count < kLimit; p = p -> nxt, ++count) {
+            out.write(reinterpret_cast<const char*>(&p -> pos), sizeof(Ptr));
+        }
+    }
+
+    // Read ahead the blocks listed by SaveHot in the order of the file, or,
+    // if whole and the file fits in memory, every block in use.  The blocks
+    // freed or cut off since are skipped.  The sidecar is emptied, so that a
+    // run that dies leaves no list that is out of date.
+    void WarmUp(bool whole) {
+        file.seekg(0, std::ios::end);
+        long blocks = static_cast<long>(file.tellg()) / kBlockSize;
+        Vector<Ptr> positions;
+        for (long block = 1; whole && block < blocks; ++block) {
+            if (freeMap.IsFree(block)) continue;
+            if (positions.Size() == kLimit) {
+                positions.Clear();
+                break;
+            }
+            positions.PushBack(block * kBlockSize);
+        }
+        bool listed = positions.Empty();
+        std::ifstream in(fileName + "_hot", std::ios::binary);
+        if (in.good()) {
+            Ptr pos;
+            while (listed && positions.Size() < kLimit
+                   && in.read(reinterpret_cast<char*>(&pos), sizeof(Ptr))) {
+                long block = pos / kBlockSize;
+                if (pos % kBlockSize != 0 || block < 1 || block >= blocks || freeMap.IsFree(block)) {
+                    continue;
+                }
+                positions.PushBack(pos);
+            }
+            in.close();
+            std::ofstream(fileName + "_hot", std::ios::binary | std::ios::trunc);
+        }
+        positions.Sort([](Ptr a, Ptr b) { return a < b; });
+        for (long i = 0; i < positions.Size();) {
+            i = Prefetch(positions, i);
+        }
+    }
+
+    // Get the blocks at positions[from], positions[from + 1] ..., as many as
+    // Prefetch takes.  They stay in memory until the next call.
+    Vector<char*> ReadMany(const Vector<Ptr>& positions, long from = 0) {
+        long end = Prefetch(positions, from);
+        Vector<char*> blocks;
+        for (long i = from; i < end; ++i) {
+            blocks.PushBack(ReadNode(positions[i], -1));
+        }
+        return blocks;
+    }
+
     MemNode* findMemory() {
         MemNode* cur = nullptr;
-        if (mp.Size() >= kLimit) {
+        while (mp.Size() >= kLimit && !sharedAccess) {
             file.seekp(rear -> pos);
             file.write(rear -> info, kBlockSize);
+            stats.Evict(kBlockSize);
             mp.Erase(mp.Find(rear -> pos));
+            delete cur;
             cur = rear;
             rear = rear -> pre;
             rear -> nxt = nullptr;
-        } else {
+        }
+        if (cur == nullptr) {
             cur = new MemNode();
             if (head == nullptr) {
                 head = rear = cur;
@@ -145,24 +325,57 @@ public:
     }
 
     Ptr Last;
-    char* AddNode() {
+    // Take the free block nearest after hint, or a new one at the end.
+    char* AddNode(Ptr hint = 0) {
+        return AddNode(hint, Last);
+    }
+
+    // The same, giving the position in pos rather than Last, which is shared
+    // by the threads adding at the same time.
+    char* AddNode(Ptr hint, Ptr &pos) {
+#ifdef CONCURRENT
+        std::lock_guard<std::mutex> guard(cacheMutex);
+#endif
         MemNode* cur = findMemory();
-        if (trash_head != nullptr) {
-            cur -> pos = trash_head -> pos;
-            Trash *tmp = trash_head;
-            trash_head = trash_head -> nxt;
-            delete tmp;
+        long block = freeMap.Take(hint / kBlockSize);
+        if (block >= 0) {
+            cur -> pos = block * kBlockSize;
         } else {
             file.seekp(0, std::ios::end);
             cur -> pos = file.tellp();
             file.write(cur -> info, kBlockSize);
+            stats.Write(kBlockSize);
         }
         mp[cur -> pos] = cur;
-        Last = cur -> pos;
+        pos = cur -> pos;
+        return cur -> info;
+    }
+
+    // Reserve count contiguous blocks at the end of the file.  Only the last
+    // byte is written, so the blocks stay a hole reading as zero until they
+    // are placed.  Deleted blocks are not reused here.
+    Ptr Reserve(long count) {
+        file.seekp(0, std::ios::end);
+        Ptr pos = file.tellp();
+        file.seekp(pos + count * kBlockSize - 1);
+        file.put('\0');
+        return pos;
+    }
+
+    // Bring a reserved block into memory, zeroed.  It holds nothing yet, so
+    // it is neither read from the file nor logged.
+    char* PlaceNode(Ptr pos) {
+        MemNode* cur = findMemory();
+        cur -> pos = pos;
+        mp[pos] = cur;
+        memset(cur -> info, 0, kBlockSize);
         return cur -> info;
     }
 
     void DelNode(Ptr pos) {
+#ifdef CONCURRENT
+        std::lock_guard<std::mutex> guard(cacheMutex);
+#endif
         auto it = mp.Find(pos);
         if (it != mp.end()) {
             MemNode* cur = it -> second;
@@ -179,11 +392,14 @@ public:
             mp.Erase(it);
             delete cur;
         }
-        trash_head = new Trash(pos, trash_head);
+        freeMap.Free(pos / kBlockSize);
     }
 
     // timeStamp >= 0 means the node will be modified
     char* ReadNode(Ptr pos, long timeStamp) {
+#ifdef CONCURRENT
+        std::lock_guard<std::mutex> guard(cacheMutex);
+#endif
         MemNode* cur = mp[pos];
         if (cur != nullptr) {
             if (head != cur) {
@@ -197,12 +413,14 @@ public:
                 head -> pre = cur;
                 head = cur;
             }
+            stats.Hit();
         } else {
             cur = findMemory();
             cur -> pos = pos;
             mp[pos] = cur;
             file.seekg(pos);
             file.read(cur -> info, kBlockSize);
+            stats.Miss(kBlockSize);
         }
         if (timeStamp >= 0) {
             rbManager.Insert(cur -> info, pos, timeStamp);
@@ -210,8 +428,11 @@ public:
         return cur -> info;
     }
 
+    // The blocks freed since timeStamp may be alive again, so the free map
+    // starts over.
     void RollBack(long timeStamp) {
         ClearMemory();
+        freeMap.Reset();
         rbManager.RollBack(file, timeStamp);
         file.seekg(0);
         file.read(meta, kBlockSize);
@@ -226,8 +447,17 @@ class MemoryManager {
 
 private:
     static constexpr int kLimit = std::max(409600 / kBlockSize, 1);
+    static_assert(kBlockSize >= kFormatOffset + 2 * sizeof(long), "no room for the format version");
+    // At most this many blocks are read ahead at a time, so that none of
+    // them is evicted before it is used.
+    static constexpr int kBatch = std::max(kLimit / 2, 1);
 
     std::fstream file;
+    // The same file for the batched reads and writes of io, which bypass
+    // the buffer of file; file is flushed before each batch.
+    int fd;
+    AsyncIO io;
+    FileStats stats;
 
     char meta[kBlockSize];
 
@@ -241,77 +471,116 @@ private:
         }
     } *head, *rear;
     LinkedHashMap<Ptr, MemNode*> mp;
+#ifdef CONCURRENT
+    // Taken by the calls made while commands run side by side: AddNode,
+    // DelNode and ReadNode.
+    std::mutex cacheMutex;
+#endif
 
-    struct Trash {
-        Ptr pos;
-        Trash* nxt;
-        Trash(Ptr _pos = -1, Trash* _nxt = nullptr): pos(_pos), nxt(_nxt) {}
-    } *trash_head;
-    Ptr old_trash;
+    std::string fileName;
+    FreeMap freeMap;
 
     void InitMeta(bool &isNew) {
         file.seekp(0, std::ios::end);
         if (file.tellp() == 0) {
             memset(meta, 0, sizeof(meta));
+            StampFormat(meta);
             file.write(meta, kBlockSize);
             isNew = true;
-            old_trash = -1;
         } else {
             file.seekg(0);
             file.read(meta, kBlockSize);
+            CheckFormat(meta, fileName);
             isNew = false;
-            old_trash = *(reinterpret_cast<Ptr*>(meta + 16));
         }
     }
 
 public:
     MemoryManager(const char* filename, bool &isNew) : 
-        file(filename, std::ios::in | std::ios::out | std::ios::binary) {
+        file(filename, std::ios::in | std::ios::out | std::ios::binary),
+        fd(open(filename, O_RDWR | O_CLOEXEC)), stats(filename), fileName(filename),
+        freeMap(fileName) {
         head = rear = nullptr;
-        trash_head = nullptr;
         InitMeta(isNew);
+        if (!isNew) freeMap.Load();
     }
     ~MemoryManager() {
+        SaveHot();
+        Trim();
+        file.close();
+        close(fd);
+        freeMap.Save();
+    }
+
+    // Write the memory back, and cut the free blocks off the end of the file.
+    void Trim() {
         ClearMemory();
+        file.seekp(0, std::ios::end);
+        long blocks = static_cast<long>(file.tellp()) / kBlockSize;
+        long kept = freeMap.TrimTail(blocks);
+        if (kept < blocks) {
+            file.flush();
+            truncate(fileName.c_str(), kept * kBlockSize);
+        }
+    }
+
+    // Rewrite the file with the blocks in order, the i-th of them moving to
+    // block i + 1 and the meta block staying first.  relink(block, moved)
+    // fixes the pointers in a copy of each block, where moved maps an old
+    // position to the new one.  The new file is built next to the old one
+    // and renamed over it, so either of them is whole at any time.
+    template<class Relink>
+    void Rewrite(const Vector<Ptr>& order, Relink relink) {
+        LinkedHashMap<Ptr, Ptr> moved;
+        for (long i = 0; i < order.Size(); ++i) {
+            moved[order[i]] = (i + 1) * kBlockSize;
+        }
+        auto newPos = [&moved](Ptr pos) { return moved[pos]; };
+        std::string compactName = fileName + "_compact";
+        std::ofstream out(compactName, std::ios::binary | std::ios::trunc);
+        out.write(meta, kBlockSize);
+        char block[kBlockSize];
+        long readTo = 0;
+        for (long i = 0; i < order.Size(); ++i) {
+            if (i == readTo) readTo = Prefetch(order, i);
+            memcpy(block, ReadNode(order[i]), kBlockSize);
+            relink(block, newPos);
+            out.write(block, kBlockSize);
+        }
+        out.close();
+        stats.Write((order.Size() + 1) * kBlockSize);
+        DropMemory();
         file.close();
+        close(fd);
+        rename(compactName.c_str(), fileName.c_str());
+        file.open(fileName, std::ios::in | std::ios::out | std::ios::binary);
+        fd = open(fileName.c_str(), O_RDWR | O_CLOEXEC);
+        freeMap.Reset();
     }
 
     char* GetMeta() {
         return meta;
     }
 
+    FileStats& Stats() {
+        return stats;
+    }
+
     void ClearMemory() {
+        WriteBack();
         mp.Clear();
         for (MemNode* p = head; p != nullptr;) {
             MemNode* q = p -> nxt;
-            file.seekp(p -> pos);
-            file.write(p -> bpInfo, kBlockSize);
             delete p;
             p = q;
         }
         head = rear = nullptr;
-        if (trash_head == nullptr) {
-            *(reinterpret_cast<Ptr*>(meta + 16)) = old_trash;
-        } else {
-            *(reinterpret_cast<Ptr*>(meta + 16)) = trash_head -> pos;
-            for (Trash* p = trash_head; p != nullptr; ) {
-                Trash* q = p -> nxt;
-                file.seekp(p -> pos);
-                if (q == nullptr) {
-                    file.write((char*)&old_trash, sizeof(Ptr));
-                } else {
-                    file.write((char*)&(q -> pos), sizeof(Ptr));
-                }
-                delete p;
-                p = q;
-            }
-            trash_head = nullptr;
-        }
         file.seekp(0);
         file.write((char*)&meta, kBlockSize);
     }
 
-    void Clear() {
+    // Forget the memory without writing it back.
+    void DropMemory() {
         mp.Clear();
         for (MemNode* p = head; p != nullptr;) {
             MemNode* q = p -> nxt;
@@ -321,16 +590,130 @@ public:
         head = rear = nullptr;
     }
 
+    // Nothing is referenced any more, so every block but the meta one is free.
+    void Clear() {
+        DropMemory();
+        file.seekp(0, std::ios::end);
+        freeMap.FreeRange(1, static_cast<long>(file.tellp()) / kBlockSize);
+    }
+
+    // Write every block in memory back in one batch, in the order of the
+    // file.
+    void WriteBack() {
+        Vector<AsyncIO::Request> writes;
+        for (MemNode* p = head; p != nullptr; p = p -> nxt) {
+            writes.PushBack(AsyncIO::Request{p -> pos, p -> bpInfo, kBlockSize});
+        }
+        writes.Sort([](const AsyncIO::Request& a, const AsyncIO::Request& b) {
+            return a.offset < b.offset;
+        });
+        file.flush();
+        io.Write(fd, writes);
+        stats.Write(writes.Size() * kBlockSize);
+    }
+
+    // Read the blocks at positions[from], positions[from + 1] ... that are
+    // not in memory with one batch of reads, up to kBatch positions, e.g.
+    // all the trains a query is about to go through.  Returns the index
+    // after the last position taken, where the caller reads ahead again
+    // once it gets there.
+    long Prefetch(const Vector<Ptr>& positions, long from = 0) {
+#ifdef CONCURRENT
+        std::lock_guard<std::mutex> guard(cacheMutex);
+#endif
+        Vector<AsyncIO::Request> reads;
+        long end = std::min(positions.Size(), from + kBatch);
+        for (long i = from; i < end; ++i) {
+            Ptr pos = positions[i];
+            if (mp.Contains(pos)) continue;
+            MemNode* cur = findMemory();
+            cur -> pos = pos;
+            mp[pos] = cur;
+            reads.PushBack(AsyncIO::Request{pos, cur -> bpInfo, kBlockSize});
+            stats.Prefetch(kBlockSize);
+        }
+        if (!reads.Empty()) {
+            reads.Sort([](const AsyncIO::Request& a, const AsyncIO::Request& b) {
+                return a.offset < b.offset;
+            });
+            file.flush(); // the blocks evicted above
+            io.Read(fd, reads);
+        }
+        return end;
+    }
+
+    // Write the positions of the blocks in memory, the most recently used
+    // first, to the sidecar named after the file with a _hot suffix, so that
+    // the next run can read them ahead.
+    void SaveHot() {
+        std::ofstream out(fileName + "_hot", std::ios::binary | std::ios::trunc);
+        long count = 0;
+        for (MemNode* p = head; p != nullptr && count < kLimit; p = p -> nxt, ++count) {
+            out.write(reinterpret_cast<const char*>(&p -> pos), sizeof(Ptr));
+        }
+    }
+
+    // Read ahead the blocks listed by SaveHot in the order of the file, or,
+    // if whole and the file fits in memory, every block in use.  The blocks
+    // freed or cut off since are skipped.  The sidecar is emptied, so that a
+    // run that dies leaves no list that is out of date.
+    void WarmUp(bool whole) {
+        file.seekg(0, std::ios::end);
+        long blocks = static_cast<long>(file.tellg()) / kBlockSize;
+        Vector<Ptr> positions;
+        for (long block = 1; whole && block < blocks; ++block) {
+            if (freeMap.IsFree(block)) continue;
+            if (positions.Size() == kLimit) {
+                positions.Clear();
+                break;
+            }
+            positions.PushBack(block * kBlockSize);
+        }
+        bool listed = positions.Empty();
+        std::ifstream in(fileName + "_hot", std::ios::binary);
+        if (in.good()) {
+            Ptr pos;
+            while (listed && positions.Size() < kLimit
+                   && in.read(reinterpret_cast<char*>(&pos), sizeof(Ptr))) {
+                long block = pos / kBlockSize;
+                if (pos % kBlockSize != 0 || block < 1 || block >= blocks || freeMap.IsFree(block)) {
+                    continue;
+                }
+                positions.PushBack(pos);
+            }
+            in.close();
+            std::ofstream(fileName + "_hot", std::ios::binary | std::ios::trunc);
+        }
+        positions.Sort([](Ptr a, Ptr b) { return a < b; });
+        for (long i = 0; i < positions.Size();) {
+            i = Prefetch(positions, i);
+        }
+    }
+
+    // Get the blocks at positions[from], positions[from + 1] ..., as many as
+    // Prefetch takes.  They stay in memory until the next call.
+    Vector<char*> ReadMany(const Vector<Ptr>& positions, long from = 0) {
+        long end = Prefetch(positions, from);
+        Vector<char*> blocks;
+        for (long i = from; i < end; ++i) {
+            blocks.PushBack(ReadNode(positions[i]));
+        }
+        return blocks;
+    }
+
     MemNode* findMemory() {
         MemNode* cur = nullptr;
-        if (mp.Size() >= kLimit) {
+        while (mp.Size() >= kLimit && !sharedAccess) {
             file.seekp(rear -> pos);
             file.write(rear -> bpInfo, kBlockSize);
+            stats.Evict(kBlockSize);
             mp.Erase(mp.Find(rear -> pos));
+            delete cur;
             cur = rear;
             rear = rear -> pre;
             rear -> nxt = nullptr;
-        } else {
+        }
+        if (cur == nullptr) {
             cur = new MemNode();
             if (head == nullptr) {
                 head = rear = cur;
@@ -346,28 +729,57 @@ public:
     }
 
     Ptr Last;
-    char* AddNode() {
+    // Take the free block nearest after hint, or a new one at the end.
+    char* AddNode(Ptr hint = 0) {
+        return AddNode(hint, Last);
+    }
+
+    // The same, giving the position in pos rather than Last, which is shared
+    // by the threads adding at the same time.
+    char* AddNode(Ptr hint, Ptr &pos) {
+#ifdef CONCURRENT
+        std::lock_guard<std::mutex> guard(cacheMutex);
+#endif
         MemNode* cur = findMemory();
-        if (trash_head != nullptr) {
-            cur -> pos = trash_head -> pos;
-            Trash *tmp = trash_head;
-            trash_head = trash_head -> nxt;
-            delete tmp;
-        } else if (old_trash != -1) {
-            cur -> pos = old_trash;
-            file.seekg(old_trash);
-            file.read((char*)&old_trash, sizeof(Ptr));
+        long block = freeMap.Take(hint / kBlockSize);
+        if (block >= 0) {
+            cur -> pos = block * kBlockSize;
         } else {
             file.seekp(0, std::ios::end);
             cur -> pos = file.tellp();
             file.write(cur -> bpInfo, kBlockSize);
+            stats.Write(kBlockSize);
         }
         mp[cur -> pos] = cur;
-        Last = cur -> pos;
+        pos = cur -> pos;
+        return cur -> bpInfo;
+    }
+
+    // Reserve count contiguous blocks at the end of the file.  Only the last
+    // byte is written, so the blocks stay a hole reading as zero until they
+    // are placed.  Deleted blocks are not reused here.
+    Ptr Reserve(long count) {
+        file.seekp(0, std::ios::end);
+        Ptr pos = file.tellp();
+        file.seekp(pos + count * kBlockSize - 1);
+        file.put('\0');
+        return pos;
+    }
+
+    // Bring a reserved block into memory, zeroed.  It holds nothing yet, so
+    // it is neither read from the file nor logged.
+    char* PlaceNode(Ptr pos) {
+        MemNode* cur = findMemory();
+        cur -> pos = pos;
+        mp[pos] = cur;
+        memset(cur -> bpInfo, 0, kBlockSize);
         return cur -> bpInfo;
     }
 
     void DelNode(Ptr pos) {
+#ifdef CONCURRENT
+        std::lock_guard<std::mutex> guard(cacheMutex);
+#endif
         auto it = mp.Find(pos);
         if (it != mp.end()) {
             MemNode* cur = it -> second;
@@ -384,10 +796,13 @@ public:
             mp.Erase(it);
             delete cur;
         }
-        trash_head = new Trash(pos, trash_head);
+        freeMap.Free(pos / kBlockSize);
     }
 
     char* ReadNode(Ptr pos) {
+#ifdef CONCURRENT
+        std::lock_guard<std::mutex> guard(cacheMutex);
+#endif
         MemNode* cur = mp[pos];
         if (cur != nullptr) {
             if (head != cur) {
@@ -401,12 +816,14 @@ public:
                 head -> pre = cur;
                 head = cur;
             }
+            stats.Hit();
         } else {
             cur = findMemory();
             cur -> pos = pos;
             mp[pos] = cur;
             file.seekg(pos);
             file.read(cur -> bpInfo, kBlockSize);
+            stats.Miss(kBlockSize);
         }
         return cur -> bpInfo;
     }
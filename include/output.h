@@ -0,0 +1,106 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TICKET_SYSTEM_INCLUDE_OUTPUT_H
+#define TICKET_SYSTEM_INCLUDE_OUTPUT_H
+
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "fixed_string.h"
+
+// The output is flushed at command boundaries by main(), never per line.
+#define ENDL '\n'
+
+/**
+ * A write buffer in front of a file descriptor.
+ * <br>
+ * Everything is formatted straight into the buffer, and the buffer is only
+ * written out when it is full or when <code>Flush()</code> is called, so a
+ * query printing thousands of lines costs a single write.
+ */
+class OutputBuffer {
+public:
+    static constexpr int kBufferSize = 1 << 16;
+
+    explicit OutputBuffer(int fileDescriptor) : fileDescriptor_(fileDescriptor) {}
+
+    OutputBuffer(const OutputBuffer&) = delete;
+
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    /**
+     * Write out what remains in the buffer.
+     */
+    ~OutputBuffer();
+
+    OutputBuffer& operator<<(char c) {
+        if (size_ == kBufferSize) Flush();
+        buffer_[size_++] = c;
+        return *this;
+    }
+
+    OutputBuffer& operator<<(std::string_view string);
+
+    OutputBuffer& operator<<(const char* string) {
+        return *this << std::string_view(string);
+    }
+
+    OutputBuffer& operator<<(int value) {
+        return *this << static_cast<long>(value);
+    }
+
+    OutputBuffer& operator<<(long value);
+
+    /**
+     * Write the buffer to the file descriptor, or append it to the sink.
+     */
+    void Flush();
+
+    /**
+     * Send what is flushed from now on to the end of a string instead of
+     * the file descriptor, e.g. to collect the reply to one client; nullptr
+     * goes back to the file descriptor.  The buffer should be flushed
+     * before switching.
+     */
+    void Redirect(std::string* sink) { sink_ = sink; }
+
+private:
+    void Write_(const char* data, long size);
+
+    char buffer_[kBufferSize];
+    int  size_ = 0;
+    int  fileDescriptor_;
+    std::string* sink_ = nullptr;
+};
+
+template<long size>
+OutputBuffer& operator<<(OutputBuffer& os, const FixedString<size>& string) {
+    return os << std::string_view(string.Data(), strlen(string.Data()));
+}
+
+/**
+ * The standard output of the system.  Under CONCURRENT every thread has its
+ * own buffer, which a reader redirects to the reply it is building.
+ */
+#ifdef CONCURRENT
+extern thread_local OutputBuffer output;
+#else
+extern OutputBuffer output;
+#endif // CONCURRENT
+
+#endif // TICKET_SYSTEM_INCLUDE_OUTPUT_H
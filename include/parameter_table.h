@@ -17,31 +17,125 @@
 #ifndef TICKET_SYSTEM_INCLUDE_PARAMETER_TABLE_H
 #define TICKET_SYSTEM_INCLUDE_PARAMETER_TABLE_H
 
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <string_view>
 
+/**
+ * The commands of the system.  The order here is also the index of the
+ * command in the dispatch table of main.cpp.
+ */
+enum class Command {
+    addUser,
+    login,
+    logout,
+    queryProfile,
+    modifyProfile,
+    addTrain,
+    deleteTrain,
+    releaseTrain,
+    queryTrain,
+    queryTicket,
+    queryTransfer,
+    buyTicket,
+    queryOrder,
+    refundTicket,
+    rollback,
+    clean,
+    compact,
+    stats,
+    exit,
+    unknown,
+};
+
+constexpr int kCommandCount = static_cast<int>(Command::unknown);
+
+/**
+ * Get the name of a command as it is written in the input.
+ */
+std::string_view CommandName(Command command);
+
+/**
+ * Tell whether a command only reads the data, so that it may run at the
+ * same time as other such commands.
+ */
+bool IsReadOnly(Command command);
+
+/**
+ * Resolve a command name with a perfect hash over the fixed command set.
+ * @return the command, or <code>Command::unknown</code> if there is no such
+ *         command
+ */
+Command ParseCommand(std::string_view name);
+
+/**
+ * The parsed form of one command line.
+ * <br>
+ * The line is kept in a buffer that is reused across commands, and every
+ * flag is stored as an (offset, length) pair into that buffer, so reading a
+ * command does not allocate once the buffer has grown to the longest line.
+ * The views returned by <code>operator[]</code> are only valid until the
+ * next call of <code>ReadNewLine</code> or <code>Parse</code>.
+ */
 class ParameterTable {
 public:
     ParameterTable() = default;
 
     ~ParameterTable() = default;
 
-    [[nodiscard]] std::string& operator[](char c);
-    [[nodiscard]] const std::string& operator[](char c) const;
+    /**
+     * Get the value of a flag.
+     * @param c the flag, from 'a' to 'z'
+     * @return the value, or an empty view if the flag is not given
+     */
+    [[nodiscard]] std::string_view operator[](char c) const;
+
+    /**
+     * Get the value of a flag as an integer.  The value is parsed at the
+     * first call and cached for the rest of the command.
+     * @param c the flag, from 'a' to 'z'
+     * @return the integer, or 0 if the flag is not given
+     */
+    [[nodiscard]] int GetInt(char c) const;
 
-    [[nodiscard]] const std::string& GetCommand() const;
+    [[nodiscard]] Command GetCommand() const;
 
     void ReadNewLine();
 
+    /**
+     * Parse a line that is kept by the caller, e.g. a line of a whole input
+     * read by <code>BatchReader</code>.  The line must stay alive and
+     * unchanged until the next line is parsed.
+     */
+    void Parse(std::string_view line);
+
     [[nodiscard]] long TimeStamp() const;
 
+    /**
+     * Get the whole line of the command, as valid as the flags.
+     */
+    [[nodiscard]] std::string_view Line() const;
+
 #ifdef LAU_TEST
     void Print() const;
 #endif // LAU_TEST
 
 private:
-    long timeStamp_;
-    std::string command_;
-    std::string table_[26];
+    struct Field {
+        int offset;
+        int length;
+    };
+
+    std::string buffer_;
+    const char* line_ = nullptr; // the line that the fields point into
+    int lineSize_ = 0;
+    long timeStamp_ = 0;
+    Command command_ = Command::unknown;
+    Field table_[26];
+    std::uint32_t given_ = 0; // bit i is set if the flag 'a' + i is given
+    mutable std::uint32_t parsed_ = 0; // bit i is set if intTable_[i] is valid
+    mutable int intTable_[26];
 };
 
 #endif // TICKET_SYSTEM_INCLUDE_PARAMETER_TABLE_H
@@ -0,0 +1,81 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TICKET_SYSTEM_INCLUDE_SEAT_COUNT_H
+#define TICKET_SYSTEM_INCLUDE_SEAT_COUNT_H
+
+#include "seat_kernels.h"
+
+/**
+ * The remaining seats of a train on one day, station by station.  Entry i
+ * is the number of seats left from station i to station i + 1.
+ * <br>
+ * The entries are a plain array, and every query is one pass over a run of
+ * it on the kernels of seat_kernels.h.  With at most 100 stations a pass is
+ * a few vector instructions, which beats keeping block minima up to date.
+ * <br>
+ * The class is trivially copyable so that it can be stored in a
+ * <code>TileStorage</code> as it is.  An all-zero SeatCount answers every
+ * query inside [1, stationNum) like <code>Reset(stationNum, 0)</code>, so
+ * the days a train is not on sale are left as zeroed memory.
+ */
+class SeatCount {
+public:
+    static constexpr int kStationCount = 100;
+
+    /**
+     * Give stations [1, stationNum) seatNum seats each.  The other entries
+     * are never part of a query.
+     */
+    void Reset(int stationNum, int seatNum) {
+        for (int i = 0; i < kStationCount; ++i) {
+            seats_[i] = (i >= 1 && i < stationNum) ? seatNum : 0;
+        }
+    }
+
+    /**
+     * Get the seats left from station i to station i + 1.
+     */
+    [[nodiscard]] int Get(int i) const {
+        return seats_[i];
+    }
+
+    /**
+     * Get the minimum number of seats over the stations [from, to).
+     */
+    [[nodiscard]] int Min(int from, int to) const {
+        return RangeMin(seats_ + from, to - from);
+    }
+
+    /**
+     * Add value to the seats of the stations [from, to).
+     */
+    void Add(int from, int to, int value) {
+        RangeAdd(seats_ + from, to - from, value);
+    }
+
+    /**
+     * Tell whether every station in [from, to) has at least count seats.
+     */
+    [[nodiscard]] bool AllAtLeast(int from, int to, int count) const {
+        return FirstBelow(seats_ + from, to - from, count) == to - from;
+    }
+
+private:
+    int seats_[kStationCount];
+};
+
+#endif // TICKET_SYSTEM_INCLUDE_SEAT_COUNT_H
@@ -0,0 +1,95 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TICKET_SYSTEM_INCLUDE_SEAT_KERNELS_H
+#define TICKET_SYSTEM_INCLUDE_SEAT_KERNELS_H
+
+#include <algorithm>
+#include <climits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * The loops over runs of seat counters.  A kernel is kept only where it
+ * beats the plain loop in bench-seat-kernels: the range minimum and the
+ * range addition are plain loops, which the compiler vectorizes by itself
+ * as well as by hand, and only the early-exit search has kernels, in AVX2
+ * when the compiler targets it (see NATIVE in CMakeLists.txt) and in SSE2,
+ * which every x86-64 build has, otherwise.  The vector part handles whole
+ * registers and the tail is done one by one, so the kernels take any count
+ * and any start.
+ */
+
+#if defined(__AVX2__)
+constexpr const char* kSeatKernels = "avx2";
+#elif defined(__SSE2__)
+constexpr const char* kSeatKernels = "sse2";
+#else
+constexpr const char* kSeatKernels = "scalar";
+#endif
+
+/**
+ * Get the minimum of data[0, count), or INT_MAX if count is 0.
+ */
+inline int RangeMin(const int* data, int count) {
+    int result = INT_MAX;
+    for (int i = 0; i < count; ++i) {
+        result = std::min(result, data[i]);
+    }
+    return result;
+}
+
+/**
+ * Add value to every entry of data[0, count).
+ */
+inline void RangeAdd(int* data, int count, int value) {
+    for (int i = 0; i < count; ++i) {
+        data[i] += value;
+    }
+}
+
+/**
+ * Find the first entry of data[0, count) that is less than bound.
+ * @return its index, or count if every entry is at least bound
+ */
+inline int FirstBelow(const int* data, int count, int bound) {
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i bounds = _mm256_set1_epi32(bound);
+    for (; i + 8 <= count; i += 8) {
+        __m256i below = _mm256_cmpgt_epi32(bounds,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(below));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+#elif defined(__SSE2__)
+    __m128i bounds = _mm_set1_epi32(bound);
+    for (; i + 4 <= count; i += 4) {
+        __m128i below = _mm_cmplt_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), bounds);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(below));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+#endif
+    for (; i < count; ++i) {
+        if (data[i] < bound) return i;
+    }
+    return count;
+}
+
+#endif // TICKET_SYSTEM_INCLUDE_SEAT_KERNELS_H
@@ -0,0 +1,128 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TICKET_SYSTEM_INCLUDE_SERVER_H
+#define TICKET_SYSTEM_INCLUDE_SERVER_H
+
+#include <string>
+#include <string_view>
+
+#include "linked_hash_map.h"
+#include "vector.h"
+
+/**
+ * A Unix domain socket front end serving many clients at once.
+ * <br>
+ * The clients are multiplexed with epoll.  A client sends command lines,
+ * and gets back the output of each command followed by an empty line, in
+ * the order of its commands.  Commands run one at a time, and clients with
+ * a complete line take turns, so a client sending a long batch does not
+ * hold up the others.
+ * <br>
+ * SIGINT and SIGTERM stop the server between two commands, so that the
+ * data is written back just like on <code>exit</code>.
+ */
+class Server {
+public:
+    /**
+     * Listen on the socket path, replacing a stale socket left there by an
+     * earlier run.
+     */
+    explicit Server(const char* path);
+
+    Server(const Server&) = delete;
+
+    Server& operator=(const Server&) = delete;
+
+    /**
+     * Close every connection and remove the socket.
+     */
+    ~Server();
+
+    [[nodiscard]] bool Listening() const { return epollFd_ >= 0; }
+
+    /**
+     * Wait for the next command line of any client.
+     * <br>
+     * The view is only valid until the next call.
+     * @return false once the server is asked to stop
+     */
+    bool NextLine(std::string_view& line, int& client);
+
+    /**
+     * Get the next command line if one has already arrived, without
+     * waiting.  The view is only valid until the next call.
+     * @return false if there is none, or the server is asked to stop
+     */
+    bool TryNextLine(std::string_view& line, int& client);
+
+    /**
+     * Send the reply to the last line of the client.
+     * @param close whether to close the connection once the reply is sent
+     */
+    void Reply(int client, std::string_view reply, bool close);
+
+private:
+    struct Connection {
+        int fd;
+        std::string input;
+        long consumed = 0;   // the bytes of input handed out as lines
+        std::string output;
+        long sent = 0;       // the bytes of output already sent
+        bool queued = false; // in ready_
+        bool closing = false;
+        bool hungUp = false; // the client will send nothing more
+    };
+
+    /**
+     * Hand out the next line of the first client in turn that has one.
+     */
+    bool Take_(std::string_view& line, int& client);
+
+    /**
+     * Wait for events for up to timeout milliseconds, -1 meaning no limit.
+     * @return false if the wait fails
+     */
+    bool Poll_(int timeout);
+
+    void Accept_();
+
+    void Read_(Connection* connection);
+
+    void Write_(Connection* connection);
+
+    void Watch_(Connection* connection, bool writable);
+
+    /**
+     * Close the connection if nothing is left to do with it.
+     * @return true if it is closed
+     */
+    bool CloseIfDone_(Connection* connection);
+
+    void Close_(Connection* connection);
+
+    [[nodiscard]] static bool HasLine_(const Connection* connection);
+
+    std::string path_;
+    int listenFd_ = -1;
+    int epollFd_  = -1;
+    int signalFd_ = -1;
+    bool stopped_ = false;
+    LinkedHashMap<int, Connection*> connections_;
+    Vector<int> ready_; // the clients with a complete line, in turn order
+};
+
+#endif // TICKET_SYSTEM_INCLUDE_SERVER_H
@@ -0,0 +1,258 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef TICKET_SYSTEM_INCLUDE_STATS_H
+#define TICKET_SYSTEM_INCLUDE_STATS_H
+
+#include <string>
+#ifdef STATS
+#include <atomic>
+#include <chrono>
+
+#include "output.h"
+#include "parameter_table.h"
+#endif // STATS
+
+/**
+ * Where the time of a command goes: looking up the indexes, reading the
+ * records, writing the output, and everything else.
+ */
+enum class Phase {
+    index,
+    fetch,
+    compute,
+    output,
+};
+
+constexpr int kPhaseCount = 4;
+
+#ifdef STATS
+
+/**
+ * A count that threads may add to at the same time.  Under CONCURRENT the
+ * additions are relaxed atomics: a count read meanwhile may miss the latest
+ * of them, but none is lost.
+ */
+class Counter {
+public:
+#ifdef CONCURRENT
+    void Add(long n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+
+    [[nodiscard]] long Get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<long> value_{0};
+#else
+    void Add(long n = 1) { value_ += n; }
+
+    [[nodiscard]] long Get() const { return value_; }
+
+private:
+    long value_ = 0;
+#endif // CONCURRENT
+};
+
+/**
+ * A histogram of durations in nanoseconds with a bounded relative error,
+ * in the manner of HdrHistogram.
+ * <br>
+ * The values below 2^kSubBits have a bucket each; above that every power of
+ * two is cut into 2^kSubBits buckets of the same width, so a value is off
+ * by at most 1/16 of itself, and recording one is a count of leading zeros
+ * and an addition.  The last bucket takes everything above 2^41 ns, about
+ * 36 minutes.
+ */
+class Histogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr int kBuckets = 38 << kSubBits;
+
+    void Record(long nanoseconds);
+
+    [[nodiscard]] long Count() const { return count_.Get(); }
+
+    [[nodiscard]] long Total() const { return total_.Get(); }
+
+    /**
+     * Get the value that a fraction of the records do not exceed.
+     * @param fraction from 0 to 1, e.g. 0.99 for the 99th percentile
+     * @return the upper bound of the bucket of that record, or 0 if there
+     *         is no record
+     */
+    [[nodiscard]] long Percentile(double fraction) const;
+
+private:
+    static int Bucket_(unsigned long value);
+
+    static long UpperBound_(int bucket);
+
+    Counter buckets_[kBuckets];
+    Counter count_;
+    Counter total_;
+};
+
+/**
+ * What happens to the blocks of one file of <code>MemoryManager</code>.
+ * <br>
+ * A record adds itself to the list printed by <code>PrintStats</code> when
+ * it is made and leaves it when it is destroyed, so every open file shows
+ * up once, under the name it was opened with.
+ * <br>
+ * A block read ahead by <code>Prefetch</code> counts as prefetched rather
+ * than as a miss, and a later read of it as a hit.  The visits and splits
+ * are only counted by the B+ trees, one visit per node read.
+ */
+class FileStats {
+public:
+    explicit FileStats(std::string name);
+
+    FileStats(const FileStats&) = delete;
+
+    FileStats& operator=(const FileStats&) = delete;
+
+    ~FileStats();
+
+    void Hit() { hits_.Add(); }
+
+    void Miss(long bytes) {
+        misses_.Add();
+        bytesRead_.Add(bytes);
+    }
+
+    void Prefetch(long bytes) {
+        prefetched_.Add();
+        bytesRead_.Add(bytes);
+    }
+
+    // An evicted block is written back.
+    void Evict(long bytes) {
+        evictions_.Add();
+        bytesWritten_.Add(bytes);
+    }
+
+    void Write(long bytes) { bytesWritten_.Add(bytes); }
+
+    void Visit() { visits_.Add(); }
+
+    void Split() { splits_.Add(); }
+
+private:
+    friend void PrintStats(OutputBuffer& os);
+
+    std::string name_;
+    Counter hits_;
+    Counter misses_;
+    Counter prefetched_;
+    Counter evictions_;
+    Counter bytesRead_;
+    Counter bytesWritten_;
+    Counter visits_;
+    Counter splits_;
+};
+
+/**
+ * Charges the time of the command running on this thread to a phase, from
+ * when it is made to when it is switched to another phase or destroyed.
+ * The phase before it goes on after it, so timers may nest, and every
+ * nanosecond is charged to exactly one phase.  A switch costs a read of the
+ * clock.
+ */
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase phase);
+
+    PhaseTimer(const PhaseTimer&) = delete;
+
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    ~PhaseTimer();
+
+    void Switch(Phase phase);
+
+private:
+    Phase previous_;
+};
+
+/**
+ * Times a whole command on this thread.  When it is destroyed, the time is
+ * added to the histogram of the kind of the command, and if it is at least
+ * the threshold of the slow log, the time spent in each phase is written
+ * there together with the command line.  The line of the command must stay
+ * alive until then.
+ */
+class CommandTimer {
+public:
+    explicit CommandTimer(const ParameterTable& command);
+
+    CommandTimer(const CommandTimer&) = delete;
+
+    CommandTimer& operator=(const CommandTimer&) = delete;
+
+    ~CommandTimer();
+
+private:
+    const ParameterTable& command_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * Log every command that takes at least a threshold, one line each,
+ * appended to a file.
+ * @param path the file, created if there is none
+ * @param thresholdMicroseconds the threshold; 0 logs every command
+ * @return false if the file cannot be opened
+ */
+bool OpenSlowLog(const char* path, long thresholdMicroseconds);
+
+/**
+ * Print the latency of every kind of command that has run, in
+ * microseconds, and the counts of every open file.
+ */
+void PrintStats(OutputBuffer& os);
+
+#else
+
+// Without STATS nothing is counted, and the calls compile to nothing.
+class FileStats {
+public:
+    explicit FileStats(const std::string&) {}
+
+    void Hit() {}
+
+    void Miss(long) {}
+
+    void Prefetch(long) {}
+
+    void Evict(long) {}
+
+    void Write(long) {}
+
+    void Visit() {}
+
+    void Split() {}
+};
+
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase) {}
+
+    void Switch(Phase) {}
+};
+
+#endif // STATS
+
+#endif // TICKET_SYSTEM_INCLUDE_STATS_H
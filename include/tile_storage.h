@@ -49,9 +49,28 @@ public:
      * @return the file position in this class.
      */
     Ptr Add(const T& value) {
-        char* data = memoryManager_.AddNode();
+        Ptr position;
+        char* data = memoryManager_.AddNode(0, position);
         memcpy(data, &value, sizeof(T));
-        return memoryManager_.Last;
+        return position;
+    }
+
+    /**
+     * Reserve count contiguous records at the end of the file.  They read as
+     * zero, and take no disk space, until they are placed and written back.
+     * @return the position of the first record
+     */
+    Ptr Reserve(long count) {
+        return memoryManager_.Reserve(count);
+    }
+
+    /**
+     * Get a reserved record to fill in.  The record starts zeroed, and is
+     * neither read from the file nor logged for rollback.  The reference is
+     * only valid until the next call on this storage.
+     */
+    T& Place(Ptr position) {
+        return *(reinterpret_cast<T*>(memoryManager_.PlaceNode(position)));
     }
 
 #ifdef ROLLBACK
@@ -81,6 +100,23 @@ public:
     }
 #endif
 
+    /**
+     * Get the values at positions[from], positions[from + 1] ..., as many as
+     * the cache holds at once.  The records that are not cached are read in
+     * one batch, in the order of the file and with neighbouring records in
+     * one read.
+     * @return the values in the order of positions, the caller going on
+     *         from from + size; they are only valid until the next call on
+     *         this storage
+     */
+    Vector<const T*> GetMany(const Vector<Ptr>& positions, long from = 0) {
+        Vector<const T*> values;
+        for (char* data : memoryManager_.ReadMany(positions, from)) {
+            values.PushBack(reinterpret_cast<const T*>(data));
+        }
+        return values;
+    }
+
     /**
      * Modify the data at the position with the newValue and the time stamp.
      * @return the position of the new value
@@ -101,6 +137,24 @@ public:
         memoryManager_.Clear();
     }
 
+    /**
+     * Read ahead the records used last time, or all of them if whole and
+     * they fit in memory.
+     */
+    void WarmUp(bool whole) {
+        memoryManager_.WarmUp(whole);
+    }
+
+#ifndef ROLLBACK
+    /**
+     * Write the cache back and cut the free records off the end of the file.
+     * The records are never moved, since their positions are kept elsewhere.
+     */
+    void Trim() {
+        memoryManager_.Trim();
+    }
+#endif
+
 #ifdef ROLLBACK
     void RollBack(long timeStamp) {
         memoryManager_.RollBack(timeStamp);
@@ -18,8 +18,11 @@
 #define TICKET_SYSTEM_INCLUDE_TRAIN_H
 
 #include <iostream>
+#include <string_view>
 
 #include "fixed_string.h"
+#include "output.h"
+#include "seat_count.h"
 
 using TrainID = FixedString<20>;
 using Station = FixedString<40>;
@@ -27,7 +30,7 @@ using Station = FixedString<40>;
 struct Date {
     Date() = default;
     explicit Date(int day) : day(day) {}
-    explicit Date(const std::string& string);
+    explicit Date(std::string_view string);
 
     bool operator<(const Date& rhs) const;
     bool operator>(const Date& rhs) const;
@@ -38,7 +41,7 @@ struct Date {
     Date& operator-=(int rhs);
     Date operator-(int rhs);
 
-    friend std::ostream& operator<<(std::ostream& os, const Date& date);
+    friend OutputBuffer& operator<<(OutputBuffer& os, const Date& date);
 
     int day;
 };
@@ -46,7 +49,7 @@ struct Date {
 struct Time {
     Time() = default;
     explicit Time(int minute) : minute(minute) {}
-    explicit Time(const std::string& string);
+    explicit Time(std::string_view string);
     Time(const Time&) = default;
     bool operator<(const Time& rhs) const;
     bool operator>(const Time& rhs) const;
@@ -58,7 +61,7 @@ struct Time {
     Time& operator+=(int rhs);
     Time operator+(int rhs);
 
-    friend std::ostream& operator<<(std::ostream& os, const Time& time);
+    friend OutputBuffer& operator<<(OutputBuffer& os, const Time& time);
 
     int minute;
 };
@@ -88,7 +91,7 @@ struct Journey {
     int price;
     int seat;
 
-    friend std::ostream& operator<<(std::ostream& os, const Journey& journey) {
+    friend OutputBuffer& operator<<(OutputBuffer& os, const Journey& journey) {
         os << journey.trainID << " " << journey.startStation << " "
            << journey.startDate << " " << journey.startTime << " -> "
            << journey.endStation << " " << journey.endDate << " "
@@ -103,6 +106,12 @@ enum class TicketState {
     bought = 1,
 };
 
+/**
+ * The key of an order in the order index: the hash of the user name and the
+ * number of the order, counting from 1 in the order of purchase.
+ */
+using OrderKey = Pair<HashPair, int>;
+
 struct Ticket {
     TrainID trainID;
     Station startStation;
@@ -118,9 +127,8 @@ struct Ticket {
     int  seatNum;
     int  from, to;
     TicketState state; // 1 for bought, 0 for queuing, -1 for refunded
-    long last = -1; // the last query
-    long queue = -1; // the next queuing order
-    friend std::ostream& operator<<(std::ostream& os, const Ticket& ticket) {
+    long timeStamp; // when the order was made
+    friend OutputBuffer& operator<<(OutputBuffer& os, const Ticket& ticket) {
         if (ticket.state == TicketState::bought) {
             os << "[success] ";
         } else if (ticket.state == TicketState::pending) {
@@ -136,13 +144,68 @@ struct Ticket {
     }
 };
 
+// Tickets are written to user_ticket_data as they are, so a new layout needs
+// a new kFormatVersion (memory.h).  This catches the layouts of another size.
+static_assert(sizeof(Ticket) == 176, "the layout of Ticket changed: bump kFormatVersion");
+
+/**
+ * The key of a pending order in the pending index.  The orders of a train
+ * on a day are adjacent and sorted by the time they were made, so a range
+ * scan visits the waitlist in FIFO order.  Time stamps may repeat (they
+ * start over when the system restarts), so the position of the ticket is
+ * part of the key to keep it unique.
+ */
+struct PendingKey {
+    long train; // the position of the train
+    int  day;
+    long timeStamp;
+    long ticket; // the position of the ticket
+
+    bool operator<(const PendingKey& rhs) const {
+        if (train != rhs.train) return train < rhs.train;
+        if (day != rhs.day) return day < rhs.day;
+        if (timeStamp != rhs.timeStamp) return timeStamp < rhs.timeStamp;
+        return ticket < rhs.ticket;
+    }
+
+    bool operator==(const PendingKey& rhs) const {
+        return train == rhs.train && day == rhs.day && timeStamp == rhs.timeStamp
+               && ticket == rhs.ticket;
+    }
+};
+
+/**
+ * A pending order as kept in the pending index.  The segment and the seat
+ * number are copied from the ticket so that a refund can tell whether the
+ * order may be served without reading the ticket itself.
+ */
+struct PendingOrder {
+    long ticket; // the position of the ticket
+    int  from, to;
+    int  seatNum;
+};
+
+/**
+ * The remaining seats of a train.  With ROLLBACK every day of the train is a
+ * record of its own, so that a purchase only logs the day it changes;
+ * otherwise all the days are kept in one record.  <code>Day()</code> hides
+ * the difference from the callers.
+ */
 #ifdef ROLLBACK
 struct TrainTicketCount {
-    int remained[100];
+    SeatCount seats;
+
+    SeatCount& Day(int day) { return seats; }
+
+    [[nodiscard]] const SeatCount& Day(int day) const { return seats; }
 };
 #else
 struct TrainTicketCount {
-    int remained[100][100];
+    SeatCount days[100];
+
+    SeatCount& Day(int day) { return days[day]; }
+
+    [[nodiscard]] const SeatCount& Day(int day) const { return days[day]; }
 };
 #endif
 
@@ -46,18 +46,46 @@ public:
 
     void TryBuy(ParameterTable& input, UserManage& userManage);
 
-    long AddOrder(Ticket& ticket, long timeStamp);
+    long AddOrder(Ticket& ticket, const OrderKey& key, long timeStamp);
 
     void QueryOrder(ParameterTable& input, UserManage& userManage);
 
     void Refund(ParameterTable& input, UserManage& userManage);
 
+#ifndef ROLLBACK
+    /**
+     * Get the train that a buy_ticket or refund_ticket works on.  Such
+     * commands on different trains only share the users, and the indexes
+     * that lock themselves, so they can run side by side.  The refunded
+     * order is looked up as things stand, so an earlier command of the same
+     * user must have run first.
+     * @return the position of the train, or -1 if the command fails before
+     *         it gets to a train
+     */
+    long TrainOf(ParameterTable& input, UserManage& userManage);
+#endif
+
 #ifdef ROLLBACK
     void RollBack(long timeStamp);
 #endif
 
     void Clear();
 
+    /**
+     * Read ahead the blocks of every file that were in memory at the last
+     * clean shutdown.  With preload, the files that fit in memory, e.g.
+     * train_index, are read whole instead.
+     */
+    void WarmUp(bool preload);
+
+#ifndef ROLLBACK
+    /**
+     * Rewrite the B+ trees in the order of their leaves, and cut the free
+     * blocks off the ends of the other files.
+     */
+    void Compact();
+#endif
+
 private:
 #ifdef ROLLBACK
     BPTree<HashPair, long>        trainIndex_   = BPTree<HashPair, long>("train_index", "train_index_log");
@@ -65,12 +93,17 @@ private:
     TileStorage<TrainTicketCount> ticketData_   = TileStorage<TrainTicketCount>("ticket_data", "ticket_data_log");
     BPTree<HashPair, StationPair> stationIndex_ = BPTree<HashPair, StationPair>("station_index", "station_index_log");
     TileStorage<Ticket>         userTicketData_ = TileStorage<Ticket>("user_ticket_data", "user_ticket_data_log");
+    BPTree<OrderKey, long>        orderIndex_   = BPTree<OrderKey, long>("order_index", "order_index_log");
+    BPTree<PendingKey, PendingOrder> pendingIndex_
+        = BPTree<PendingKey, PendingOrder>("pending_index", "pending_index_log");
 #else
     BPTree<HashPair, long>        trainIndex_     = BPTree<HashPair, long>("train_index");
     TileStorage<Train>            trainData_      = TileStorage<Train>("train_data");
     TileStorage<TrainTicketCount> ticketData_     = TileStorage<TrainTicketCount>("ticket_data");
     BPTree<HashPair, StationPair> stationIndex_   = BPTree<HashPair, StationPair>("station_index");
     TileStorage<Ticket>           userTicketData_ = TileStorage<Ticket>("user_ticket_data");
+    BPTree<OrderKey, long>        orderIndex_     = BPTree<OrderKey, long>("order_index");
+    BPTree<PendingKey, PendingOrder> pendingIndex_ = BPTree<PendingKey, PendingOrder>("pending_index");
 #endif
 };
 
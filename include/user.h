@@ -30,8 +30,12 @@ struct User {
     Password   password;
     Name       name; // Actually a UTF-8 string
     mailAdress mailAddress;
-    long       orderInfo = -1; // for ``query_order''
+    int        orderCount = 0; // the number of the user's latest order
     int        privilege = 0;
 };
 
+// Users are written to user_data as they are, so a new layout needs a new
+// kFormatVersion (memory.h).  This catches the layouts of another size.
+static_assert(sizeof(User) == 104, "the layout of User changed: bump kFormatVersion");
+
 #endif // TICKET_SYSTEM_INCLUDE_USER_H
@@ -26,41 +26,74 @@
 #include "user.h"
 #include "utility.h"
 
+#include "vector.h"
+
 class TrainManage;
 
+/**
+ * The slot of a logged-in user in the login pool.  A slot is given at login
+ * and stays the same until logout, so it can be kept in place of the user
+ * name for the rest of a command, or by a client for the whole session.
+ */
+using SessionId = int;
+
+constexpr SessionId kNoSession = -1;
+
+struct Session {
+    User     user;     // the record of the user
+    long     position; // the position of the record in user_data
+    HashPair userHash; // the hash of the user name
+    bool     dirty = false; // the order count is newer than the one in user_data
+};
+
+/**
+ * The logged-in users.  The name of a user is only hashed to find its
+ * slot; everything else works on the slot, which is an index into a dense
+ * array of sessions.  The slots of logged-out users are reused.
+ */
 class LoginPool {
 public:
     LoginPool() = default;
 
     ~LoginPool() = default;
 
-    void Login(const User& user);
+    SessionId Login(const User& user, long position);
 
-    void Logout(const UserName& userName);
+    void Logout(SessionId id);
 
-    bool Contains(const FixedString<20>& name); // Tell whether a user has logged in
+    /**
+     * Find the session of a user.
+     * @return the slot of the user, or kNoSession if it hasn't logged in
+     */
+    SessionId Find(std::string_view name);
 
-    bool Contains(const std::string& name); // Tell whether a user has logged in
+    bool Contains(std::string_view name); // Tell whether a user has logged in
 
-    const User& GetData(const FixedString<20>& name);
+    Session& operator[](SessionId id);
 
-    const User& GetData(const std::string& name);
-
-    void ModifyProfile(const User& user);
+    /**
+     * Get the number of slots, including the free ones.
+     */
+    [[nodiscard]] SessionId SlotCount() const;
 
     void Clear();
 
     bool Empty();
 
 private:
-    LinkedHashMap<UserName, User, FixedStringHash1> loginUserMap_;
+    LinkedHashMap<UserName, SessionId, FixedStringHash1> sessionIds_;
+    Vector<Session>   sessions_;
+    Vector<SessionId> freeSlots_;
 };
 
 class UserManage {
 public:
     UserManage() = default;
 
-    ~UserManage() = default;
+    /**
+     * Write back what the sessions keep of their users.
+     */
+    ~UserManage() { Checkpoint(); }
 
     void AddUser(ParameterTable& input);
 
@@ -72,9 +105,15 @@ public:
 
     void Modify(ParameterTable& input);
 
-    bool Logged(const std::string& name);
+    /**
+     * Find the session of a logged-in user.
+     * @return the slot of the user, or kNoSession if it hasn't logged in
+     */
+    SessionId FindSession(std::string_view name);
+
+    const Session& GetSession(SessionId session);
 
-    long AddOrder(const std::string& name, Ticket& ticket, long timeStamp, TrainManage& trainManage);
+    long AddOrder(SessionId session, Ticket& ticket, long timeStamp, TrainManage& trainManage);
 
 #ifdef ROLLBACK
     void RollBack(long timeStamp);
@@ -82,11 +121,32 @@ public:
 
     void Clear();
 
-    const User& GetUser(const std::string& name);
+    /**
+     * The same as <code>TrainManage::WarmUp</code>, for user_index and
+     * user_data.
+     */
+    void WarmUp(bool preload);
+
+#ifndef ROLLBACK
+    /**
+     * Rewrite user_index in the order of its leaves, and cut the free blocks
+     * off the end of user_data.
+     */
+    void Compact();
+#endif
+
+    /**
+     * Write the order counts kept in the sessions to user_data.  Without
+     * ROLLBACK a purchase only counts the order in the session, and the
+     * record is written at logout or here.
+     */
+    void Checkpoint();
 
 private:
     void Adduser_(User& user, long timeStamp);
 
+    void WriteBack_(Session& session);
+
     LoginPool loginPool_;
 
 #ifdef ROLLBACK
@@ -18,14 +18,9 @@
 #define TICKET_SYSTEM_INCLUDE_UTILITY_H
 
 #include <iostream>
+#include <string_view>
 #include <utility>
 
-#ifdef BOOST
-#define ENDL "\n"
-#else
-#define ENDL std::endl
-#endif
-
 template<class T1, class T2>
 class Pair {
 public:
@@ -56,13 +51,21 @@ public:
 
 using HashPair = Pair<std::size_t, std::size_t>;
 
+/**
+ * Hash a HashPair into one word.  The two halves are mixed rather than
+ * xor-ed, since equal halves would otherwise all land in bucket 0.
+ */
 class HashPairHash {
 public:
-    bool operator()(const HashPair& pair) const {
-        return pair.first ^ pair.second;
+    std::size_t operator()(const HashPair& pair) const {
+        std::size_t hash = pair.first ^ (pair.second * 0x9e3779b97f4a7c15ull);
+        hash ^= hash >> 32;
+        hash *= 0xd6e8feb86659fd93ull;
+        hash ^= hash >> 32;
+        return hash;
     }
 };
 
-int StringToInt(const std::string& string);
+int StringToInt(std::string_view string);
 
 #endif // TICKET_SYSTEM_INCLUDE_UTILITY_H
@@ -266,7 +266,7 @@ public:
                                 beginIndex_(0) {
         target_ = new T*[capacity_];
         for (SizeT i = 0; i < size_; ++i) {
-            target_[i] = new T(obj.target_[i + obj.beginIndex_]);
+            target_[i] = new T(*(obj.target_[i + obj.beginIndex_]));
         }
     }
 
@@ -301,15 +301,17 @@ public:
     }
 
     Vector& operator=(Vector&& obj) noexcept {
+        if (&obj == this) return *this;
         this->Clear();
         capacity_ = obj.capacity_;
         size_ = obj.size_;
         beginIndex_ = obj.beginIndex_;
-        target_ = obj.beginIndex_;
+        target_ = obj.target_;
         obj.target_ = nullptr;
         obj.capacity_ = 0;
         obj.size_ = 0;
         obj.beginIndex_ = 0;
+        return *this;
     }
 
     ~Vector() { this->Clear(); }
@@ -0,0 +1,79 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TICKET_SYSTEM_INCLUDE_WORKER_POOL_H
+#define TICKET_SYSTEM_INCLUDE_WORKER_POOL_H
+
+#ifdef CONCURRENT
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "vector.h"
+
+/**
+ * A fixed set of threads running commands side by side: runs of read-only
+ * commands, or the trains of a run of purchases and refunds.
+ * <br>
+ * The pool only ever runs one round of tasks at a time, and the caller
+ * takes part in it, so nothing else touches the data while a round is on.
+ */
+class WorkerPool {
+public:
+    /**
+     * Start the threads; the caller is one of the workers, so count - 1
+     * threads are started.
+     */
+    explicit WorkerPool(int count);
+
+    WorkerPool(const WorkerPool&) = delete;
+
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool();
+
+    /**
+     * Run task(0), ..., task(count - 1) on the workers, and return once all
+     * of them are done.
+     */
+    void Run(long count, const std::function<void(long)>& task);
+
+private:
+    void Work_();
+
+    /**
+     * Take tasks of the current round until there are none left.
+     */
+    void Drain_();
+
+    Vector<std::thread*> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    long round_ = 0;     // the number of rounds started
+    long busy_ = 0;      // the threads still in the current round
+    bool stopping_ = false;
+    const std::function<void(long)>* task_ = nullptr;
+    long count_ = 0;
+    std::atomic<long> next_{0}; // the next task to take
+};
+
+#endif // CONCURRENT
+
+#endif // TICKET_SYSTEM_INCLUDE_WORKER_POOL_H
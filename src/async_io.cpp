@@ -0,0 +1,213 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "async_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif // IO_URING
+
+namespace {
+
+// Drop the first bytes of a list of vectors.
+void Skip(iovec*& vectors, long& count, long bytes) {
+    while (count > 0 && bytes >= static_cast<long>(vectors->iov_len)) {
+        bytes -= static_cast<long>(vectors->iov_len);
+        ++vectors;
+        --count;
+    }
+    if (count > 0 && bytes > 0) {
+        vectors->iov_base = static_cast<char*>(vectors->iov_base) + bytes;
+        vectors->iov_len -= bytes;
+    }
+}
+
+// Read or write all of the vectors at offset, as preadv and pwritev may do
+// only part of it.
+void Transfer(int fileDescriptor, iovec* vectors, long count, long offset, bool write) {
+    while (count > 0) {
+        int part = static_cast<int>(std::min(count, static_cast<long>(IOV_MAX)));
+        long done = write ? pwritev(fileDescriptor, vectors, part, offset)
+                          : preadv(fileDescriptor, vectors, part, offset);
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (done == 0) {
+            for (long i = 0; !write && i < count; ++i) {
+                memset(vectors[i].iov_base, 0, vectors[i].iov_len);
+            }
+            return;
+        }
+        offset += done;
+        Skip(vectors, count, done);
+    }
+}
+
+}
+
+AsyncIO::AsyncIO() {
+#ifdef IO_URING
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ring = static_cast<int>(syscall(__NR_io_uring_setup, kEntries, &params));
+    if (ring < 0) return;
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring, IORING_OFF_SQ_RING);
+    cqRing_ = single ? sqRing_
+                     : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    void* sqes = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe),
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    ring_ = ring;
+    entries_ = params.sq_entries;
+    if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes == MAP_FAILED) {
+        if (sqRing_ == MAP_FAILED) sqRing_ = nullptr;
+        if (cqRing_ == MAP_FAILED) cqRing_ = nullptr;
+        if (sqes != MAP_FAILED) munmap(sqes, entries_ * sizeof(io_uring_sqe));
+        CloseRing_();
+        return;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+    char* sq = static_cast<char*>(sqRing_);
+    char* cq = static_cast<char*>(cqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+#endif // IO_URING
+}
+
+AsyncIO::~AsyncIO() {
+#ifdef IO_URING
+    CloseRing_();
+#endif // IO_URING
+}
+
+void AsyncIO::Read(int fileDescriptor, const Vector<Request>& requests) {
+    Run_(fileDescriptor, requests, false);
+}
+
+void AsyncIO::Write(int fileDescriptor, const Vector<Request>& requests) {
+    Run_(fileDescriptor, requests, true);
+}
+
+void AsyncIO::Run_(int fileDescriptor, const Vector<Request>& requests, bool write) {
+    std::unique_ptr<iovec[]> vectors(new iovec[requests.Size()]);
+    Vector<Run> runs;
+    for (long i = 0; i < requests.Size(); ++i) {
+        const Request& request = requests[i];
+        vectors[i].iov_base = request.data;
+        vectors[i].iov_len = request.size;
+        if (!runs.Empty() && runs.Back().offset + runs.Back().size == request.offset &&
+            runs.Back().count < IOV_MAX) {
+            ++runs.Back().count;
+            runs.Back().size += request.size;
+        } else {
+            runs.PushBack(Run{&vectors[i], 1, request.offset, request.size});
+        }
+    }
+
+    long done = 0;
+#ifdef IO_URING
+    while (ring_ >= 0 && done < runs.Size()) {
+        long count = std::min(static_cast<long>(entries_), runs.Size() - done);
+        if (Submit_(fileDescriptor, runs, done, count, write)) {
+            done += count;
+        } else {
+            CloseRing_(); // the rest, this batch too, is done below
+        }
+    }
+#endif // IO_URING
+    for (long i = done; i < runs.Size(); ++i) {
+        const Run& run = runs[i];
+        Transfer(fileDescriptor, run.vectors, run.count, run.offset, write);
+    }
+}
+
+#ifdef IO_URING
+bool AsyncIO::Submit_(int fileDescriptor, const Vector<Run>& runs,
+                      long from, long count, bool write) {
+    unsigned tail = *sqTail_;
+    for (long i = 0; i < count; ++i) {
+        const Run& run = runs[from + i];
+        unsigned index = (tail + i) & *sqMask_;
+        io_uring_sqe& entry = sqes_[index];
+        memset(&entry, 0, sizeof(entry));
+        entry.opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+        entry.fd = fileDescriptor;
+        entry.off = run.offset;
+        entry.addr = reinterpret_cast<unsigned long>(run.vectors);
+        entry.len = static_cast<unsigned>(run.count);
+        entry.user_data = from + i;
+        sqArray_[index] = index;
+    }
+    tail += count;
+    __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+
+    long completed = 0;
+    while (completed < count) {
+        unsigned unsubmitted = tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        long result = syscall(__NR_io_uring_enter, ring_, unsubmitted, count - completed,
+                              IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (result < 0 && errno != EINTR) return false;
+        unsigned head = *cqHead_;
+        unsigned end = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (; head != end; ++head) {
+            const io_uring_cqe& event = cqes_[head & *cqMask_];
+            const Run& run = runs[static_cast<long>(event.user_data)];
+            // An error or a short transfer: finish the run by hand.
+            if (event.res != run.size) {
+                long transferred = event.res > 0 ? event.res : 0;
+                iovec* vectors = run.vectors;
+                long left = run.count;
+                Skip(vectors, left, transferred);
+                Transfer(fileDescriptor, vectors, left, run.offset + transferred, write);
+            }
+            ++completed;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+void AsyncIO::CloseRing_() {
+    if (sqes_ != nullptr) munmap(sqes_, entries_ * sizeof(io_uring_sqe));
+    if (cqRing_ != nullptr && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+    if (sqRing_ != nullptr) munmap(sqRing_, sqRingSize_);
+    sqes_ = nullptr;
+    sqRing_ = cqRing_ = nullptr;
+    if (ring_ >= 0) close(ring_);
+    ring_ = -1;
+}
+#endif // IO_URING
@@ -0,0 +1,90 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "batch_reader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+BatchReader::BatchReader(int fileDescriptor) : fileDescriptor_(fileDescriptor) {
+    struct stat status{};
+    if (fstat(fileDescriptor_, &status) == 0 && S_ISREG(status.st_mode)
+        && status.st_size > 0) {
+        void* address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE,
+                             fileDescriptor_, 0);
+        if (address != MAP_FAILED) {
+            madvise(address, status.st_size, MADV_SEQUENTIAL);
+            mapped_ = static_cast<char*>(address);
+            mappedSize_ = status.st_size;
+            cursor_ = mapped_;
+            end_ = mapped_ + mappedSize_;
+            exhausted_ = true;
+            return;
+        }
+    }
+    capacity_ = kBlockSize;
+    block_ = new char[capacity_];
+    cursor_ = end_ = block_;
+}
+
+BatchReader::~BatchReader() {
+    if (mapped_ != nullptr) munmap(mapped_, mappedSize_);
+    delete[] block_;
+}
+
+bool BatchReader::NextLine(std::string_view& line) {
+    while (true) {
+        auto lineEnd = static_cast<const char*>(memchr(cursor_, '\n', end_ - cursor_));
+        if (lineEnd != nullptr) {
+            line = std::string_view(cursor_, lineEnd - cursor_);
+            cursor_ = lineEnd + 1;
+            return true;
+        }
+        if (exhausted_ || !Fill_()) {
+            exhausted_ = true;
+            if (cursor_ == end_) return false;
+            // the last line has no line break
+            line = std::string_view(cursor_, end_ - cursor_);
+            cursor_ = end_;
+            return true;
+        }
+    }
+}
+
+bool BatchReader::Fill_() {
+    long rest = end_ - cursor_;
+    if (rest == capacity_) {
+        char* larger = new char[capacity_ * 2];
+        memcpy(larger, cursor_, rest);
+        delete[] block_;
+        block_ = larger;
+        capacity_ *= 2;
+    } else if (cursor_ != block_) {
+        memmove(block_, cursor_, rest);
+    }
+    cursor_ = block_;
+    end_ = block_ + rest;
+    while (true) {
+        long count = read(fileDescriptor_, block_ + rest, capacity_ - rest);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        end_ += count;
+        return true;
+    }
+}
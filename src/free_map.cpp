@@ -0,0 +1,111 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "free_map.h"
+
+#include <cstring>
+#include <fstream>
+
+FreeMap::FreeMap(const std::string& fileName) : sidecar_(fileName + "_free") {}
+
+void FreeMap::Load() {
+    std::ifstream in(sidecar_, std::ios::binary | std::ios::ate);
+    if (in.good()) {
+        long wordCount = static_cast<long>(in.tellg()) / static_cast<long>(sizeof(std::uint64_t));
+        if (wordCount > 0) {
+            Grow_(wordCount);
+            in.seekg(0);
+            in.read(reinterpret_cast<char*>(words_), wordCount * sizeof(std::uint64_t));
+            for (long i = 0; i < wordCount; ++i) {
+                freeCount_ += __builtin_popcountll(words_[i]);
+            }
+        }
+        in.close();
+        std::ofstream(sidecar_, std::ios::binary | std::ios::trunc);
+    }
+}
+
+FreeMap::~FreeMap() {
+    delete[] words_;
+}
+
+void FreeMap::Free(long block) {
+    if (block / 64 >= wordCount_) Grow_(block / 64 + 1);
+    std::uint64_t bit = std::uint64_t(1) << (block % 64);
+    if (!(words_[block / 64] & bit)) {
+        words_[block / 64] |= bit;
+        ++freeCount_;
+    }
+}
+
+void FreeMap::FreeRange(long from, long to) {
+    for (long block = from; block < to; ++block) {
+        Free(block);
+    }
+}
+
+long FreeMap::Take(long hint) {
+    if (freeCount_ == 0) return -1;
+    long start = hint / 64;
+    if (hint < 0 || start >= wordCount_) start = hint = 0;
+    // The word of the hint only counts from the hint on; the bits before it
+    // come last, at the end of the wrap-around.
+    std::uint64_t word = words_[start] & (~std::uint64_t(0) << (hint % 64));
+    long w = start;
+    while (word == 0) {
+        if (++w == wordCount_) w = 0;
+        word = words_[w];
+    }
+    long block = w * 64 + __builtin_ctzll(word);
+    words_[w] &= ~(std::uint64_t(1) << (block % 64));
+    --freeCount_;
+    return block;
+}
+
+void FreeMap::Reset() {
+    if (wordCount_ > 0) memset(words_, 0, wordCount_ * sizeof(std::uint64_t));
+    freeCount_ = 0;
+}
+
+long FreeMap::TrimTail(long blockCount) {
+    while (blockCount > 1 && Test_(blockCount - 1)) {
+        --blockCount;
+        words_[blockCount / 64] &= ~(std::uint64_t(1) << (blockCount % 64));
+        --freeCount_;
+    }
+    return blockCount;
+}
+
+void FreeMap::Save() const {
+    long used = wordCount_;
+    while (used > 0 && words_[used - 1] == 0) --used;
+    std::ofstream out(sidecar_, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(words_), used * sizeof(std::uint64_t));
+}
+
+bool FreeMap::Test_(long block) const {
+    return block / 64 < wordCount_ && (words_[block / 64] >> (block % 64) & 1);
+}
+
+void FreeMap::Grow_(long wordCount) {
+    long newCount = wordCount_ == 0 ? 16 : wordCount_;
+    while (newCount < wordCount) newCount *= 2;
+    auto* words = new std::uint64_t[newCount]();
+    if (wordCount_ > 0) memcpy(words, words_, wordCount_ * sizeof(std::uint64_t));
+    delete[] words_;
+    words_ = words;
+    wordCount_ = newCount;
+}
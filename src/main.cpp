@@ -14,102 +14,473 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <unistd.h>
 
+#include "batch_reader.h"
+#include "output.h"
 #include "parameter_table.h"
+#include "worker_pool.h"
+#include "server.h"
+#include "stats.h"
 #include "train_manage.h"
 #include "user_manage.h"
 
 
+#ifdef STATS
+// The commands taking at least this many microseconds go to the slow log,
+// unless --slow-threshold says otherwise.
+constexpr long kSlowThreshold = 10000;
+#endif // STATS
+
 void TryCreateFile(const char* fileName);
 
 void Init();
 
 bool Request(ParameterTable& parameterTable, UserManage& users, TrainManage& trains);
 
-int main() {
+void RunBatch(ParameterTable& parameterTable, UserManage& users, TrainManage& trains);
+
+int RunServer(const char* path, ParameterTable& parameterTable, UserManage& users, TrainManage& trains);
+
+int main(int argc, char** argv) {
 #ifdef BOOST
     std::ios::sync_with_stdio(false);
     std::cin.tie(nullptr);
-    std::cout.tie(nullptr);
 #endif // BOOST
 
     Init();
+#ifdef STATS
+    const char* slowLog = nullptr;
+    long slowThreshold = kSlowThreshold;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--slow-log") == 0) {
+            slowLog = argv[i + 1];
+        } else if (strcmp(argv[i], "--slow-threshold") == 0) {
+            slowThreshold = std::max(std::atol(argv[i + 1]), 0l);
+        }
+    }
+    if (slowLog != nullptr && !OpenSlowLog(slowLog, slowThreshold)) {
+        std::cerr << "cannot open the slow log " << slowLog << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+#endif // STATS
     ParameterTable parameterTable;
     TrainManage trainManage;
     UserManage userManage;
+    bool preload = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--preload") == 0) preload = true;
+    }
+    trainManage.WarmUp(preload);
+    userManage.WarmUp(preload);
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            RunBatch(parameterTable, userManage, trainManage);
+            return 0;
+        }
+        if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            return RunServer(argv[i + 1], parameterTable, userManage, trainManage);
+        }
+    }
     while (std::cin) {
         parameterTable.ReadNewLine();
         if (!Request(parameterTable, userManage, trainManage)) {
             break;
         }
+#ifndef BOOST
+        // Someone may be waiting for the answer before sending the next
+        // command, so the output cannot wait for the buffer to fill up.
+        output.Flush();
+#endif // BOOST
     }
+    output.Flush();
     return 0;
 }
 
-bool Request(ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
-    if (parameterTable.GetCommand() == "add_user") {
-        users.AddUser(parameterTable);
-    } else if (parameterTable.GetCommand() == "login") {
-        users.Login(parameterTable);
-    } else if (parameterTable.GetCommand() == "logout") {
-        users.Logout(parameterTable);
-    } else if (parameterTable.GetCommand() == "query_profile") {
-        users.Query(parameterTable);
-    } else if (parameterTable.GetCommand() == "modify_profile") {
-        users.Modify(parameterTable);
-    } else if (parameterTable.GetCommand() == "add_train") {
-        trains.Add(parameterTable);
-    } else if (parameterTable.GetCommand() == "delete_train") {
-        trains.Delete(parameterTable);
-    } else if (parameterTable.GetCommand() == "release_train") {
-        trains.Release(parameterTable);
-    } else if (parameterTable.GetCommand() == "query_train") {
-        trains.QueryTrain(parameterTable);
-    } else if (parameterTable.GetCommand() == "query_ticket") {
-        trains.QueryTicket(parameterTable);
-    } else if (parameterTable.GetCommand() == "query_transfer") {
-        trains.QueryTransfer(parameterTable);
-    } else if (parameterTable.GetCommand() == "buy_ticket") {
-        trains.TryBuy(parameterTable, users);
-    } else if (parameterTable.GetCommand() == "query_order") {
-        trains.QueryOrder(parameterTable, users);
-    } else if (parameterTable.GetCommand() == "refund_ticket") {
-        trains.Refund(parameterTable, users);
-    } else if (parameterTable.GetCommand() == "rollback") {
+namespace {
+
+using Handler = bool (*)(ParameterTable& parameterTable, UserManage& users, TrainManage& trains);
+
+bool RollBack(ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
 #ifdef ROLLBACK
-        int rollbackTimeStamp = StringToInt(parameterTable['t']);
-        if (rollbackTimeStamp > parameterTable.TimeStamp()) {
+    int rollbackTimeStamp = parameterTable.GetInt('t');
+    if (rollbackTimeStamp > parameterTable.TimeStamp()) {
 #ifdef PRETTY_PRINT
-            std::cout << "[" << parameterTable.TimeStamp()
-                      << "] Rollback failed: time stamp is newer than the current time stamp."
-                      << std::endl;
+        output << "[" << parameterTable.TimeStamp()
+                  << "] Rollback failed: time stamp is newer than the current time stamp."
+                  << ENDL;
 #else
-            std::cout << "[" << parameterTable.TimeStamp() << "] -1" << ENDL;
+        output << "[" << parameterTable.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
-        } else {
-            trains.RollBack(rollbackTimeStamp);
-            users.RollBack(rollbackTimeStamp);
+    } else {
+        trains.RollBack(rollbackTimeStamp);
+        users.RollBack(rollbackTimeStamp);
 #ifdef PRETTY_PRINT
-            std::cout << "[" << parameterTable.TimeStamp()
-                      << "] Rollback succeed: system have rolled back to "
-                      << rollbackTimeStamp << std::endl;
+        output << "[" << parameterTable.TimeStamp()
+                  << "] Rollback succeed: system have rolled back to "
+                  << rollbackTimeStamp << ENDL;
 #else
-            std::cout << "[" << parameterTable.TimeStamp() << "] 0" << ENDL;
+        output << "[" << parameterTable.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
-        }
+    }
+#else
+    output << "[" << parameterTable.TimeStamp() << "] Rollback is NOT supported!" << ENDL;
+#endif // ROLLBACK
+    return true;
+}
+
+bool Compact(ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
+#ifdef ROLLBACK
+    // The logs refer to blocks by position, and compacting moves them.
+#ifdef PRETTY_PRINT
+    output << "[" << parameterTable.TimeStamp()
+              << "] Compact failed: not supported together with rollback." << ENDL;
+#else
+    output << "[" << parameterTable.TimeStamp() << "] -1" << ENDL;
+#endif // PRETTY_PRINT
+#else
+    trains.Compact();
+    users.Compact();
+#ifdef PRETTY_PRINT
+    output << "[" << parameterTable.TimeStamp() << "] Compact succeed." << ENDL;
 #else
-        std::cout << "[" << parameterTable.TimeStamp() << "] Rollback is NOT supported!" << std::endl;
+    output << "[" << parameterTable.TimeStamp() << "] 0" << ENDL;
+#endif // PRETTY_PRINT
 #endif // ROLLBACK
-    } else if (parameterTable.GetCommand() == "clean") {
+    return true;
+}
+
+bool Stats(ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
+#ifdef STATS
+    output << "[" << parameterTable.TimeStamp() << "] stats" << ENDL;
+    PrintStats(output);
+#else
+    output << "[" << parameterTable.TimeStamp() << "] Stats is NOT supported!" << ENDL;
+#endif // STATS
+    return true;
+}
+
+// Indexed by Command; the last entry handles Command::unknown.
+constexpr Handler kHandlers[kCommandCount + 1] = {
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // add_user
+        users.AddUser(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // login
+        users.Login(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // logout
+        users.Logout(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // query_profile
+        users.Query(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // modify_profile
+        users.Modify(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // add_train
+        trains.Add(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // delete_train
+        trains.Delete(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // release_train
+        trains.Release(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // query_train
+        trains.QueryTrain(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // query_ticket
+        trains.QueryTicket(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // query_transfer
+        trains.QueryTransfer(input);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // buy_ticket
+        trains.TryBuy(input, users);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // query_order
+        trains.QueryOrder(input, users);
+        return true;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // refund_ticket
+        trains.Refund(input, users);
+        return true;
+    },
+    RollBack,
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // clean
         users.Clear();
         trains.Clear();
-    } else if (parameterTable.GetCommand() == "exit") {
-        std::cout << "[" << parameterTable.TimeStamp() << "] bye" << ENDL;
+        return true;
+    },
+    Compact,
+    Stats,
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // exit
+        output << "[" << input.TimeStamp() << "] bye" << ENDL;
         return false;
+    },
+    [](ParameterTable& input, UserManage& users, TrainManage& trains) { // unknown
+        return true;
+    },
+};
+
+}
+
+bool Request(ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
+#ifdef STATS
+    CommandTimer timer(parameterTable);
+#endif // STATS
+    return kHandlers[static_cast<int>(parameterTable.GetCommand())](parameterTable, users, trains);
+}
+
+/**
+ * Run the whole standard input without waiting for answers: the input is
+ * read in large blocks, and the output is only flushed when its buffer is
+ * full.  The throughput is reported on the standard error at the end.
+ */
+void RunBatch(ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
+    auto start = std::chrono::steady_clock::now();
+    long count = 0;
+    BatchReader reader(STDIN_FILENO);
+    std::string_view line;
+    while (reader.NextLine(line)) {
+        parameterTable.Parse(line);
+        ++count;
+        if (!Request(parameterTable, users, trains)) {
+            break;
+        }
     }
-    return true;
+    output.Flush();
+    double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    std::cerr << count << " commands in " << seconds << " s ("
+              << (seconds > 0 ? count / seconds : 0.0) << " commands/s)" << std::endl;
+}
+
+namespace {
+
+struct Job {
+    std::string line; // the command with the time stamp given by the server
+    int client;
+    std::string reply;
+    bool keep = true; // false after exit
+};
+
+// Stamp a command line of a client, dropping the time stamp it came with.
+void AddJob(Vector<Job>& jobs, std::string_view command, int client, long timeStamp) {
+    if (command.front() == '[') {
+        auto end = command.find(']');
+        command.remove_prefix(end == std::string_view::npos ? command.size() : end + 1);
+    }
+    Job job;
+    job.line = "[" + std::to_string(timeStamp) + "] ";
+    job.line.append(command);
+    job.client = client;
+    jobs.PushBack(job);
+}
+
+void RunJob(ParameterTable& parameterTable, Job& job, UserManage& users, TrainManage& trains) {
+    parameterTable.Parse(job.line);
+    output.Redirect(&job.reply);
+    job.keep = Request(parameterTable, users, trains);
+    output.Flush();
+    output.Redirect(nullptr);
+    job.reply += '\n';
+}
+
+}
+
+#ifdef CONCURRENT
+namespace {
+
+// The most commands run side by side at once.  Nothing is evicted from the
+// caches while they run, so this bounds how far the caches grow.
+constexpr long kMaxRun = 256;
+
+/**
+ * Add the commands that have already arrived to the run started by the
+ * first job, as long as join(index) accepts them.  The job refused, if any,
+ * stays at the end of jobs.
+ * @return the number of jobs in the run
+ */
+template<class Join>
+long Gather(Server& server, Vector<Job>& jobs, long& timeStamp, Join join) {
+    std::string_view command;
+    int client;
+    while (jobs.Size() < kMaxRun && server.TryNextLine(command, client)) {
+        AddJob(jobs, command, client, ++timeStamp);
+        if (!join(jobs.Size() - 1)) return jobs.Size() - 1;
+    }
+    return jobs.Size();
+}
+
+/**
+ * Run the read-only commands that have arrived side by side.  No command
+ * changes the data meanwhile, so they all see it as left by the commands
+ * before them.
+ */
+long RunReaders(Server& server, Vector<Job>& jobs, long& timeStamp, WorkerPool& workers,
+                ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
+    long count = Gather(server, jobs, timeStamp, [&](long i) {
+        parameterTable.Parse(jobs[i].line);
+        return IsReadOnly(parameterTable.GetCommand());
+    });
+    workers.Run(count, [&](long i) {
+        ParameterTable table;
+        RunJob(table, jobs[i], users, trains);
+    });
+    return count;
+}
+
+#ifndef ROLLBACK
+/**
+ * Run the purchases and refunds that have arrived, the trains side by side
+ * and the commands of each train in order.  Each user stays on one train,
+ * so that its orders are counted in order, and a refund can only be the
+ * first command of its user, so that the order it names is known.  The
+ * first command that breaks this ends the run.
+ * <br>
+ * With ROLLBACK the log has to be written in the order of the time stamps,
+ * so there the commands run one by one.
+ */
+long RunTrains(Server& server, Vector<Job>& jobs, long& timeStamp, WorkerPool& workers,
+               ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
+    LinkedHashMap<long, long> trainShards;     // train -> shard
+    LinkedHashMap<SessionId, long> userShards; // session -> shard
+    Vector<Vector<long>> shards;               // the jobs of each shard, in order
+    auto join = [&](long i) {
+        parameterTable.Parse(jobs[i].line);
+        Command command = parameterTable.GetCommand();
+        if (command != Command::buyTicket && command != Command::refundTicket) {
+            return false;
+        }
+        SessionId session = users.FindSession(parameterTable['u']);
+        bool seen = session != kNoSession && userShards.Contains(session);
+        if (seen && command == Command::refundTicket) {
+            return false;
+        }
+        long train = trains.TrainOf(parameterTable, users);
+        long shard = -1;
+        if (train >= 0 && trainShards.Contains(train)) {
+            shard = trainShards[train];
+        } else if (train < 0 && seen) {
+            shard = userShards[session];
+        }
+        if (seen && shard != userShards[session]) {
+            return false;
+        }
+        if (shard < 0) {
+            shard = shards.Size();
+            shards.PushBack(Vector<long>());
+            if (train >= 0) trainShards[train] = shard;
+        }
+        if (session != kNoSession) userShards[session] = shard;
+        shards[shard].PushBack(i);
+        return true;
+    };
+    join(0);
+    long count = Gather(server, jobs, timeStamp, join);
+    workers.Run(shards.Size(), [&](long shard) {
+        ParameterTable table;
+        for (long i : shards[shard]) {
+            RunJob(table, jobs[i], users, trains);
+        }
+    });
+    return count;
+}
+#endif // ROLLBACK
+
+/**
+ * Run the commands that have arrived side by side where possible.
+ * @return the number of jobs run, from the first one
+ */
+long RunSideBySide(Server& server, Vector<Job>& jobs, long& timeStamp, WorkerPool& workers,
+                   ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
+    parameterTable.Parse(jobs.Front().line);
+    Command command = parameterTable.GetCommand();
+    long count = 0;
+    sharedAccess = true;
+    if (IsReadOnly(command)) {
+        count = RunReaders(server, jobs, timeStamp, workers, parameterTable, users, trains);
+#ifndef ROLLBACK
+    } else if (command == Command::buyTicket || command == Command::refundTicket) {
+        count = RunTrains(server, jobs, timeStamp, workers, parameterTable, users, trains);
+#endif // ROLLBACK
+    }
+    sharedAccess = false;
+    return count;
+}
+
+}
+#endif // CONCURRENT
+
+/**
+ * Serve the clients of a Unix domain socket until SIGINT or SIGTERM.
+ * <br>
+ * The clients share one clock: the time stamp a client puts before a
+ * command is dropped, and the server numbers the commands in the order it
+ * takes them, going on from where the last run stopped.  The reply to a
+ * command is its output followed by an empty line.  <code>exit</code> only
+ * ends the session of its client.
+ * <br>
+ * Under CONCURRENT, the commands that have already arrived are taken in
+ * runs that can go side by side on a pool of workers: read-only commands,
+ * or purchases and refunds on different trains.  The command that ends a
+ * run is run alone after it.  The replies are the same as if the commands
+ * had run one by one.
+ * @return the exit status of the program
+ */
+int RunServer(const char* path, ParameterTable& parameterTable, UserManage& users, TrainManage& trains) {
+    Server server(path);
+    if (!server.Listening()) {
+        std::cerr << "cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    long timeStamp = 0;
+    std::ifstream("server_time_stamp") >> timeStamp;
+#ifdef CONCURRENT
+    WorkerPool workers(static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)));
+#endif // CONCURRENT
+
+    Vector<Job> jobs;
+    std::string_view command;
+    int client;
+    while (server.NextLine(command, client)) {
+        jobs.Clear();
+        AddJob(jobs, command, client, ++timeStamp);
+        long done = 0; // the jobs already run
+#ifdef CONCURRENT
+        done = RunSideBySide(server, jobs, timeStamp, workers, parameterTable, users, trains);
+#endif // CONCURRENT
+        for (long i = done; i < jobs.Size(); ++i) {
+            RunJob(parameterTable, jobs[i], users, trains);
+        }
+        for (auto& job : jobs) {
+            server.Reply(job.client, job.reply, !job.keep);
+        }
+    }
+
+    std::ofstream("server_time_stamp") << timeStamp << std::endl;
+    return 0;
 }
 
 void TryCreateFile(const char* fileName) {
@@ -129,6 +500,8 @@ void Init() {
     TryCreateFile("ticket_data");
     TryCreateFile("station_index");
     TryCreateFile("user_ticket_data");
+    TryCreateFile("order_index");
+    TryCreateFile("pending_index");
 #ifdef ROLLBACK
     TryCreateFile("user_index_log");
     TryCreateFile("user_data_log");
@@ -137,5 +510,7 @@ void Init() {
     TryCreateFile("ticket_data_log");
     TryCreateFile("station_index_log");
     TryCreateFile("user_ticket_data_log");
+    TryCreateFile("order_index_log");
+    TryCreateFile("pending_index_log");
 #endif // ROLLBACK
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "output.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+// "00" "01" ... "99", so that two digits are written at a time
+constexpr char kDigitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+void WriteAll(int fileDescriptor, const char* data, long size) {
+    while (size > 0) {
+        long written = write(fileDescriptor, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+}
+
+#ifdef CONCURRENT
+thread_local OutputBuffer output(STDOUT_FILENO);
+#else
+OutputBuffer output(STDOUT_FILENO);
+#endif // CONCURRENT
+
+OutputBuffer::~OutputBuffer() {
+    Flush();
+}
+
+OutputBuffer& OutputBuffer::operator<<(std::string_view string) {
+    if (size_ + string.size() > kBufferSize) {
+        Flush();
+        if (string.size() > kBufferSize) {
+            Write_(string.data(), static_cast<long>(string.size()));
+            return *this;
+        }
+    }
+    memcpy(buffer_ + size_, string.data(), string.size());
+    size_ += static_cast<int>(string.size());
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(long value) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* cursor = end;
+    unsigned long rest = value < 0 ? 0ul - static_cast<unsigned long>(value)
+                                   : static_cast<unsigned long>(value);
+    while (rest >= 100) {
+        cursor -= 2;
+        memcpy(cursor, kDigitPairs + rest % 100 * 2, 2);
+        rest /= 100;
+    }
+    if (rest >= 10) {
+        cursor -= 2;
+        memcpy(cursor, kDigitPairs + rest * 2, 2);
+    } else {
+        *--cursor = static_cast<char>('0' + rest);
+    }
+    if (value < 0) *--cursor = '-';
+    return *this << std::string_view(cursor, end - cursor);
+}
+
+void OutputBuffer::Flush() {
+    Write_(buffer_, size_);
+    size_ = 0;
+}
+
+void OutputBuffer::Write_(const char* data, long size) {
+    if (sink_ != nullptr) {
+        sink_->append(data, size);
+    } else {
+        WriteAll(fileDescriptor_, data, size);
+    }
+}
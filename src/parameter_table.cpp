@@ -18,15 +18,75 @@
 
 #include <iostream>
 
-#include "token_scanner.h"
+#include "utility.h"
 
 namespace {
 
-long ReadTimeStamp(const std::string& string) {
-    if (string.empty()) {
+constexpr std::string_view kCommandNames[kCommandCount] = {
+    "add_user",
+    "login",
+    "logout",
+    "query_profile",
+    "modify_profile",
+    "add_train",
+    "delete_train",
+    "release_train",
+    "query_train",
+    "query_ticket",
+    "query_transfer",
+    "buy_ticket",
+    "query_order",
+    "refund_ticket",
+    "rollback",
+    "clean",
+    "compact",
+    "stats",
+    "exit",
+};
+
+constexpr unsigned kCommandSlotCount = 64;
+
+// (length + first + 36 * last) mod 64 happens to be collision-free over the
+// command names; the static_assert below keeps it that way.
+constexpr unsigned HashCommand(std::string_view name) {
+    return (static_cast<unsigned>(name.size())
+            + static_cast<unsigned char>(name.front())
+            + 36u * static_cast<unsigned char>(name.back())) % kCommandSlotCount;
+}
+
+struct CommandSlots {
+    Command slot[kCommandSlotCount];
+};
+
+constexpr CommandSlots BuildCommandSlots() {
+    CommandSlots slots{};
+    for (auto& i : slots.slot) i = Command::unknown;
+    for (int i = 0; i < kCommandCount; ++i) {
+        slots.slot[HashCommand(kCommandNames[i])] = static_cast<Command>(i);
+    }
+    return slots;
+}
+
+constexpr bool IsPerfectHash() {
+    for (int i = 0; i < kCommandCount; ++i) {
+        for (int j = i + 1; j < kCommandCount; ++j) {
+            if (HashCommand(kCommandNames[i]) == HashCommand(kCommandNames[j])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(IsPerfectHash(), "HashCommand must be collision-free over the command names");
+
+constexpr CommandSlots kCommandSlots = BuildCommandSlots();
+
+long ReadTimeStamp(std::string_view string) {
+    if (string.size() < 2) {
         return 0;
     }
-    long cursor = 1;
+    std::size_t cursor = 1;
     long result = 0;
     if (string[cursor] == '-') {
         cursor++;
@@ -45,15 +105,55 @@ long ReadTimeStamp(const std::string& string) {
 
 }
 
-std::string& ParameterTable::operator[](char c) {
-    return table_[c - 'a'];
+std::string_view CommandName(Command command) {
+    if (command == Command::unknown) {
+        return "unknown";
+    }
+    return kCommandNames[static_cast<int>(command)];
+}
+
+bool IsReadOnly(Command command) {
+    switch (command) {
+        case Command::queryProfile:
+        case Command::queryTrain:
+        case Command::queryTicket:
+        case Command::queryTransfer:
+        case Command::queryOrder:
+            return true;
+        default:
+            return false;
+    }
+}
+
+Command ParseCommand(std::string_view name) {
+    if (name.empty()) {
+        return Command::unknown;
+    }
+    Command command = kCommandSlots.slot[HashCommand(name)];
+    if (command == Command::unknown || kCommandNames[static_cast<int>(command)] != name) {
+        return Command::unknown;
+    }
+    return command;
 }
 
-const std::string& ParameterTable::operator[](char c) const {
-    return table_[c - 'a'];
+std::string_view ParameterTable::operator[](char c) const {
+    if (!(given_ & (1u << (c - 'a')))) {
+        return {};
+    }
+    return {line_ + table_[c - 'a'].offset,
+            static_cast<std::size_t>(table_[c - 'a'].length)};
+}
+
+int ParameterTable::GetInt(char c) const {
+    std::uint32_t bit = 1u << (c - 'a');
+    if (!(parsed_ & bit)) {
+        intTable_[c - 'a'] = StringToInt((*this)[c]);
+        parsed_ |= bit;
+    }
+    return intTable_[c - 'a'];
 }
 
-const std::string& ParameterTable::GetCommand() const {
+Command ParameterTable::GetCommand() const {
     return command_;
 }
 
@@ -61,15 +161,46 @@ long ParameterTable::TimeStamp() const {
     return timeStamp_;
 }
 
+std::string_view ParameterTable::Line() const {
+    return {line_, static_cast<std::size_t>(lineSize_)};
+}
+
 void ParameterTable::ReadNewLine() {
-    TokenScanner scanner;
-    scanner.NewLine();
-    timeStamp_ = ReadTimeStamp(scanner.NextToken());
-    command_ = scanner.NextToken();
-    for (auto& i : table_) i.clear();
-    while (scanner.HasMoreToken()) {
-        char c = scanner.NextToken()[1] - 'a';
-        table_[c] = scanner.NextToken();
+    std::getline(std::cin, buffer_);
+    Parse(buffer_);
+}
+
+void ParameterTable::Parse(std::string_view text) {
+    const char* line = text.data();
+    int size = static_cast<int>(text.size());
+    line_ = line;
+    lineSize_ = size;
+    int cursor = 0;
+    // Get the next token as a field, skipping the leading spaces
+    auto nextToken = [line, size, &cursor]() -> Field {
+        while (cursor < size && line[cursor] == ' ') ++cursor;
+        int start = cursor;
+        while (cursor < size && line[cursor] != ' ') ++cursor;
+        return {start, cursor - start};
+    };
+
+    Field timeStamp = nextToken();
+    timeStamp_ = ReadTimeStamp(std::string_view(line + timeStamp.offset, timeStamp.length));
+    Field command = nextToken();
+    command_ = ParseCommand(std::string_view(line + command.offset, command.length));
+    given_ = 0;
+    parsed_ = 0;
+    while (true) {
+        Field key = nextToken();
+        if (key.length < 2) {
+            break;
+        }
+        int index = line[key.offset + 1] - 'a';
+        if (index < 0 || index >= 26) {
+            continue;
+        }
+        table_[index] = nextToken();
+        given_ |= 1u << index;
     }
 }
 
@@ -77,12 +208,12 @@ void ParameterTable::ReadNewLine() {
 
 void ParameterTable::Print() const {
     std::cout << "TimeStamp: " << timeStamp_ << std::endl;
-    std::cout << "Command: " << command_ << std::endl;
-    for (int i = 0; i < 26; ++i) {
-        if (table_[i].empty()) {
+    std::cout << "Command: " << CommandName(command_) << std::endl;
+    for (char c = 'a'; c <= 'z'; ++c) {
+        if ((*this)[c].empty()) {
             continue;
         }
-        std::cout << char('a' + i) << ": " << table_[i] << std::endl;
+        std::cout << c << ": " << (*this)[c] << std::endl;
     }
 }
 
@@ -0,0 +1,257 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "server.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int  kBacklog    = 128;
+constexpr int  kEventCount = 64;
+constexpr long kReadSize   = 1 << 16;
+
+}
+
+Server::Server(const char* path) : path_(path) {
+    sockaddr_un address{};
+    if (path_.size() >= sizeof(address.sun_path)) return;
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path_.data(), path_.size());
+
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) return;
+    struct stat status{};
+    if (stat(path_.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) unlink(path_.c_str());
+    if (bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listenFd_, kBacklog) < 0) {
+        return;
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    signalFd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd_ < 0) return;
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) return;
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd_;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd_, &event);
+    event.data.fd = signalFd_;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd_, &event);
+    epollFd_ = epollFd;
+}
+
+Server::~Server() {
+    for (auto& i : connections_) {
+        close(i.second->fd);
+        delete i.second;
+    }
+    connections_.Clear();
+    if (epollFd_ >= 0) close(epollFd_);
+    if (signalFd_ >= 0) close(signalFd_);
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+        unlink(path_.c_str());
+    }
+}
+
+bool Server::NextLine(std::string_view& line, int& client) {
+    while (!stopped_) {
+        if (Take_(line, client)) return true;
+        if (!Poll_(-1)) return false;
+    }
+    return false;
+}
+
+bool Server::TryNextLine(std::string_view& line, int& client) {
+    if (stopped_) return false;
+    return Take_(line, client) || (Poll_(0) && !stopped_ && Take_(line, client));
+}
+
+bool Server::Take_(std::string_view& line, int& client) {
+    while (!ready_.Empty()) {
+        int fd = ready_.Front();
+        ready_.PopFront();
+        if (!connections_.Contains(fd)) continue;
+        Connection* connection = connections_[fd];
+        connection->queued = false;
+        const char* begin = connection->input.data() + connection->consumed;
+        const char* end = static_cast<const char*>(
+                memchr(begin, '\n', connection->input.size() - connection->consumed));
+        if (end == nullptr) continue;
+        connection->consumed = end + 1 - connection->input.data();
+        if (HasLine_(connection)) {
+            ready_.PushBack(fd);
+            connection->queued = true;
+        }
+        if (end > begin && end[-1] == '\r') --end;
+        if (end == begin) {
+            CloseIfDone_(connection);
+            continue;
+        }
+        line = std::string_view(begin, end - begin);
+        client = fd;
+        return true;
+    }
+    return false;
+}
+
+bool Server::Poll_(int timeout) {
+    epoll_event events[kEventCount];
+    int count = epoll_wait(epollFd_, events, kEventCount, timeout);
+    if (count < 0) return errno == EINTR;
+    for (int i = 0; i < count; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == listenFd_) {
+            Accept_();
+        } else if (fd == signalFd_) {
+            signalfd_siginfo info{};
+            while (read(signalFd_, &info, sizeof(info)) > 0) {}
+            stopped_ = true;
+        } else if (connections_.Contains(fd)) {
+            Connection* connection = connections_[fd];
+            if (events[i].events & EPOLLOUT) {
+                Write_(connection);
+                if (!connections_.Contains(fd)) continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
+                Read_(connection);
+            }
+        }
+    }
+    return true;
+}
+
+void Server::Reply(int client, std::string_view reply, bool close) {
+    if (!connections_.Contains(client)) return;
+    Connection* connection = connections_[client];
+    connection->output.append(reply);
+    connection->closing = connection->closing || close;
+    Write_(connection);
+}
+
+void Server::Accept_() {
+    while (true) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        auto* connection = new Connection;
+        connection->fd = fd;
+        connections_[fd] = connection;
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void Server::Read_(Connection* connection) {
+    // Drop the lines handed out before, once they are the larger part.
+    if (connection->consumed > 0 && connection->consumed * 2 >= static_cast<long>(connection->input.size())) {
+        connection->input.erase(0, connection->consumed);
+        connection->consumed = 0;
+    }
+    while (!connection->hungUp) {
+        long size = static_cast<long>(connection->input.size());
+        connection->input.resize(size + kReadSize);
+        long got = read(connection->fd, connection->input.data() + size, kReadSize);
+        connection->input.resize(size + (got > 0 ? got : 0));
+        if (got > 0) continue;
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        connection->hungUp = true;
+    }
+    if (!connection->queued && HasLine_(connection)) {
+        ready_.PushBack(connection->fd);
+        connection->queued = true;
+    }
+    if (connection->hungUp) {
+        // Stop waking up for a peer that has nothing more to say.
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, connection->fd, nullptr);
+        if (!CloseIfDone_(connection) && connection->sent < static_cast<long>(connection->output.size())) {
+            Watch_(connection, true);
+        }
+    }
+}
+
+void Server::Write_(Connection* connection) {
+    while (connection->sent < static_cast<long>(connection->output.size())) {
+        long sent = send(connection->fd, connection->output.data() + connection->sent,
+                         connection->output.size() - connection->sent, MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection->sent += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            Watch_(connection, true);
+            return;
+        }
+        Close_(connection);
+        return;
+    }
+    bool waiting = !connection->output.empty();
+    connection->output.clear();
+    connection->sent = 0;
+    if (CloseIfDone_(connection)) return;
+    if (waiting) Watch_(connection, false);
+}
+
+void Server::Watch_(Connection* connection, bool writable) {
+    epoll_event event{};
+    event.events = writable ? EPOLLOUT : EPOLLIN | EPOLLRDHUP;
+    if (writable && !connection->hungUp) event.events |= EPOLLIN | EPOLLRDHUP;
+    event.data.fd = connection->fd;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_MOD, connection->fd, &event) < 0 && errno == ENOENT) {
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, connection->fd, &event);
+    }
+}
+
+bool Server::CloseIfDone_(Connection* connection) {
+    if (connection->sent < static_cast<long>(connection->output.size())) return false;
+    if (connection->closing || (connection->hungUp && !HasLine_(connection))) {
+        Close_(connection);
+        return true;
+    }
+    return false;
+}
+
+void Server::Close_(Connection* connection) {
+    close(connection->fd);
+    connections_.Erase(connections_.Find(connection->fd));
+    delete connection;
+}
+
+bool Server::HasLine_(const Connection* connection) {
+    return memchr(connection->input.data() + connection->consumed, '\n',
+                  connection->input.size() - connection->consumed) != nullptr;
+}
@@ -0,0 +1,224 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "stats.h"
+
+#ifdef STATS
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <utility>
+
+#include "vector.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const char* kPhaseNames[kPhaseCount] = {"index", "fetch", "compute", "output"};
+
+// Indexed by Command; the last entry is for Command::unknown.
+Histogram commandLatency[kCommandCount + 1];
+
+// The phases of the command running on a thread.
+struct Profile {
+    Phase phase = Phase::compute;
+    Clock::time_point since;
+    long time[kPhaseCount] = {};
+};
+
+#ifdef CONCURRENT
+thread_local Profile profile;
+#else
+Profile profile;
+#endif // CONCURRENT
+
+double Microseconds(long nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1000.0;
+}
+
+int slowLog = -1;
+long slowThreshold = 0; // in nanoseconds
+
+long Nanoseconds(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+// Charge the time since the last switch to the current phase.
+void SwitchTo(Phase phase) {
+    Clock::time_point now = Clock::now();
+    profile.time[static_cast<int>(profile.phase)] += Nanoseconds(now - profile.since);
+    profile.since = now;
+    profile.phase = phase;
+}
+
+// One line with O_APPEND, so that the lines of threads do not mix.
+void WriteSlowLog(std::string_view line, long total) {
+    char times[256];
+    int length = std::snprintf(times, sizeof(times), "%.1f us total", Microseconds(total));
+    std::string entry(times, length);
+    for (int i = 0; i < kPhaseCount; ++i) {
+        length = std::snprintf(times, sizeof(times), ", %.1f %s",
+                               Microseconds(profile.time[i]), kPhaseNames[i]);
+        entry.append(times, length);
+    }
+    entry += " | ";
+    entry.append(line);
+    entry += '\n';
+    const char* data = entry.data();
+    long size = static_cast<long>(entry.size());
+    while (size > 0) {
+        long written = write(slowLog, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+// The files are opened and closed by the main thread only, before and after
+// the commands run.
+Vector<FileStats*>& OpenFiles() {
+    static Vector<FileStats*> files;
+    return files;
+}
+
+}
+
+void Histogram::Record(long nanoseconds) {
+    if (nanoseconds < 0) nanoseconds = 0;
+    buckets_[Bucket_(static_cast<unsigned long>(nanoseconds))].Add();
+    count_.Add();
+    total_.Add(nanoseconds);
+}
+
+long Histogram::Percentile(double fraction) const {
+    long count = Count();
+    if (count == 0) return 0;
+    long rank = std::max(1l, static_cast<long>(std::ceil(fraction * static_cast<double>(count))));
+    long seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets_[i].Get();
+        if (seen >= rank) return UpperBound_(i);
+    }
+    return UpperBound_(kBuckets - 1);
+}
+
+int Histogram::Bucket_(unsigned long value) {
+    if (value < (1ul << kSubBits)) return static_cast<int>(value);
+    int shift = 63 - __builtin_clzl(value) - kSubBits;
+    int bucket = ((shift + 1) << kSubBits) + static_cast<int>(value >> shift) - (1 << kSubBits);
+    return std::min(bucket, kBuckets - 1);
+}
+
+long Histogram::UpperBound_(int bucket) {
+    if (bucket < (1 << kSubBits)) return bucket;
+    int shift = (bucket >> kSubBits) - 1;
+    long base = static_cast<long>((bucket & ((1 << kSubBits) - 1)) + (1 << kSubBits)) << shift;
+    return base + (1l << shift) - 1;
+}
+
+FileStats::FileStats(std::string name) : name_(std::move(name)) {
+    OpenFiles().PushBack(this);
+}
+
+FileStats::~FileStats() {
+    auto& files = OpenFiles();
+    for (long i = 0; i < files.Size(); ++i) {
+        if (files[i] == this) {
+            files.Erase(i);
+            break;
+        }
+    }
+}
+
+PhaseTimer::PhaseTimer(Phase phase) : previous_(profile.phase) {
+    SwitchTo(phase);
+}
+
+PhaseTimer::~PhaseTimer() {
+    SwitchTo(previous_);
+}
+
+void PhaseTimer::Switch(Phase phase) {
+    SwitchTo(phase);
+}
+
+CommandTimer::CommandTimer(const ParameterTable& command)
+    : command_(command), start_(Clock::now()) {
+    profile = Profile();
+    profile.since = start_;
+}
+
+CommandTimer::~CommandTimer() {
+    SwitchTo(Phase::compute);
+    long total = Nanoseconds(profile.since - start_);
+    commandLatency[static_cast<int>(command_.GetCommand())].Record(total);
+    if (slowLog >= 0 && total >= slowThreshold) {
+        WriteSlowLog(command_.Line(), total);
+    }
+}
+
+bool OpenSlowLog(const char* path, long thresholdMicroseconds) {
+    int fileDescriptor = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fileDescriptor < 0) return false;
+    if (slowLog >= 0) close(slowLog);
+    slowLog = fileDescriptor;
+    slowThreshold = thresholdMicroseconds * 1000;
+    return true;
+}
+
+void PrintStats(OutputBuffer& os) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-16s %10s %10s %10s %10s %10s %10s  (us)\n",
+                  "command", "count", "mean", "p50", "p90", "p99", "p99.9");
+    os << line;
+    for (int i = 0; i <= kCommandCount; ++i) {
+        const Histogram& histogram = commandLatency[i];
+        long count = histogram.Count();
+        if (count == 0) continue;
+        std::snprintf(line, sizeof(line), "%-16s %10ld %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                      std::string(CommandName(static_cast<Command>(i))).c_str(), count,
+                      Microseconds(histogram.Total()) / static_cast<double>(count),
+                      Microseconds(histogram.Percentile(0.5)),
+                      Microseconds(histogram.Percentile(0.9)),
+                      Microseconds(histogram.Percentile(0.99)),
+                      Microseconds(histogram.Percentile(0.999)));
+        os << line;
+    }
+    std::snprintf(line, sizeof(line), "%-24s %10s %10s %10s %10s %14s %14s %10s %8s\n",
+                  "file", "hits", "misses", "prefetched", "evictions",
+                  "bytes read", "bytes written", "visits", "splits");
+    os << line;
+    for (const FileStats* file : OpenFiles()) {
+        std::snprintf(line, sizeof(line), "%-24s %10ld %10ld %10ld %10ld %14ld %14ld %10ld %8ld\n",
+                      file->name_.c_str(), file->hits_.Get(), file->misses_.Get(),
+                      file->prefetched_.Get(), file->evictions_.Get(),
+                      file->bytesRead_.Get(), file->bytesWritten_.Get(),
+                      file->visits_.Get(), file->splits_.Get());
+        os << line;
+    }
+}
+
+#endif // STATS
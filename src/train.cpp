@@ -39,7 +39,7 @@ Date Date::operator+(int rhs) {
     return result;
 }
 
-Date::Date(const std::string& string) {
+Date::Date(std::string_view string) {
     char c = string[1];
     if (c == '6') {
         day  = (string[3] - '0') * 10 + string[4] - '0';
@@ -54,17 +54,24 @@ Date::Date(const std::string& string) {
     }
 }
 
-std::ostream& operator<<(std::ostream& os, const Date& date) {
+OutputBuffer& operator<<(OutputBuffer& os, const Date& date) {
+    int month, day;
     if (date.day > 92) {
-        os << "09-" << (date.day - 92) / 10 << (date.day - 92) % 10;
+        month = 9;
+        day = date.day - 92;
     } else if (date.day > 61) {
-        os << "08-" << (date.day - 61) / 10 << (date.day - 61) % 10;
+        month = 8;
+        day = date.day - 61;
     } else if (date.day > 30) {
-        os << "07-" << (date.day - 30) / 10 << (date.day - 30) % 10;
+        month = 7;
+        day = date.day - 30;
     } else {
-        os << "06-" << date.day / 10 << date.day % 10;
+        month = 6;
+        day = date.day;
     }
-    return os;
+    char text[5] = {'0', static_cast<char>('0' + month), '-',
+                    static_cast<char>('0' + day / 10), static_cast<char>('0' + day % 10)};
+    return os << std::string_view(text, 5);
 }
 
 Date& Date::operator-=(int rhs) {
@@ -122,15 +129,17 @@ Time Time::operator+(int rhs) {
     return result;
 }
 
-Time::Time(const std::string& string) {
+Time::Time(std::string_view string) {
     minute = (string[0] - '0') * 600 + (string[1] - '0') * 60
            + (string[3] - '0') * 10 + string[4] - '0';
 }
 
-std::ostream& operator<<(std::ostream& os, const Time& time) {
-    os << (time.minute / 60) % 24 / 10 << (time.minute / 60) % 24 % 10
-       << ":" << time.minute % 60 / 10 << time.minute % 60 % 10;
-    return os;
+OutputBuffer& operator<<(OutputBuffer& os, const Time& time) {
+    int hour = time.minute / 60 % 24;
+    int minute = time.minute % 60;
+    char text[5] = {static_cast<char>('0' + hour / 10), static_cast<char>('0' + hour % 10), ':',
+                    static_cast<char>('0' + minute / 10), static_cast<char>('0' + minute % 10)};
+    return os << std::string_view(text, 5);
 }
 
 bool Time::operator!=(const Time& rhs) const {
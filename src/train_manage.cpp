@@ -16,69 +16,78 @@
 
 #include "train_manage.h"
 
+#include <limits>
+
+#include "hash.h"
 #include "linked_hash_map.h"
-#include "token_scanner.h"
+#include "stats.h"
 #include "train.h"
 #include "utility.h"
 #include "vector.h"
 
-bool CanBuyTicket(const TrainTicketCount& ticketCount, int day, int from, int to, int count) {
-    for (int i = from; i < to; ++i) {
+// Cut the next '|'-separated item off the front of the list
+std::string_view NextItem(std::string_view& list) {
+    std::size_t end = list.find('|');
+    std::string_view item = list.substr(0, end);
+    list.remove_prefix(end == std::string_view::npos ? list.size() : end + 1);
+    return item;
+}
+
+// The position in ticket_data of the seats of a train on the day
+long TicketCountPosition(long ticketData, int day) {
 #ifdef ROLLBACK
-        if (ticketCount.remained[i] < count) {
+    return ticketData + sizeof(TrainTicketCount) * day;
 #else
-        if (ticketCount.remained[day][i] < count) {
+    return ticketData;
 #endif // ROLLBACK
-            return false;
-        }
-    }
-    return true;
 }
 
 void TrainManage::Add(ParameterTable& input) {
     Train train;
     train.trainID = input['i'];
     if (trainIndex_.Contains(ToHashPair(train.trainID))) {
+        VERIFY_HASH_HIT("train_index",
+                        trainData_.Get(trainIndex_.Find()).trainID == train.trainID);
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Add failed: train "
-                  << train.trainID << " already exists." << std::endl;
+        output << "[" << input.TimeStamp() << "] Add failed: train "
+                  << train.trainID << " already exists." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
-    train.stationNum = StringToInt(input['n']);
-    train.seatNum = StringToInt(input['m']);
+    train.stationNum = input.GetInt('n');
+    train.seatNum = input.GetInt('m');
 
-    TokenScanner stations(input['s'], '|', TokenScanner::single);
+    std::string_view stations = input['s'];
     for (int i = 1; i <= train.stationNum; ++i) {
-        train.stations[i] = stations.NextToken();
+        train.stations[i] = NextItem(stations);
     }
 
-    TokenScanner price(input['p'], '|', TokenScanner::single);
+    std::string_view price = input['p'];
     int sum = 0;
     train.prefixPriceSum[1] = 0;
     for (int i = 2; i <= train.stationNum; ++i) {
-        sum += StringToInt(price.NextToken());
+        sum += StringToInt(NextItem(price));
         train.prefixPriceSum[i] = sum;
     }
 
     Time time(input['x']);
-    TokenScanner travelTime(input['t'], '|', TokenScanner::single);
-    TokenScanner stopTime(input['o'], '|', TokenScanner::single);
+    std::string_view travelTime = input['t'];
+    std::string_view stopTime = input['o'];
     train.departureTime[1] = train.arrivalTime[1] = time;
     for (int i = 2; i < train.stationNum; ++i) {
-        time += StringToInt(travelTime.NextToken());
+        time += StringToInt(NextItem(travelTime));
         train.arrivalTime[i] = time;
-        time += StringToInt(stopTime.NextToken());
+        time += StringToInt(NextItem(stopTime));
         train.departureTime[i] = time;
     }
-    time += StringToInt(travelTime.NextToken());
+    time += StringToInt(NextItem(travelTime));
     train.arrivalTime[train.stationNum] = train.departureTime[train.stationNum] = time;
 
-    TokenScanner dates(input['d'], '|', TokenScanner::single);
-    train.startDate = Date(dates.NextToken());
-    train.endDate = Date(dates.NextToken());
+    std::string_view dates = input['d'];
+    train.startDate = Date(NextItem(dates));
+    train.endDate = Date(NextItem(dates));
 
     train.type = input['y'][0];
 
@@ -90,33 +99,34 @@ void TrainManage::Add(ParameterTable& input) {
 #endif // ROLLBACK
 
 #ifdef PRETTY_PRINT
-    std::cout << "[" << input.TimeStamp() << "] Train " << train.trainID
-              << " added successfully." << std::endl;
+    output << "[" << input.TimeStamp() << "] Train " << train.trainID
+              << " added successfully." << ENDL;
 #else
-    std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
+    output << "[" << input.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
 }
 
 void TrainManage::Delete(ParameterTable& input) {
     if (!trainIndex_.Contains(ToHashPair(input['i']))) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Delete failed: train " << input['i']
-                  << " does not exist." << std::endl;
+        output << "[" << input.TimeStamp() << "] Delete failed: train " << input['i']
+                  << " does not exist." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
     long position = trainIndex_.Find();
     Train train = trainData_.Get(position);
+    VERIFY_HASH_HIT("train_index", train.trainID == input['i']);
     if (train.released) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Delete failed: train "
+        output << "[" << input.TimeStamp() << "] Delete failed: train "
                   << train.trainID
                   << " has been released. Released Train cannot be deleted!"
-                  << std::endl;
+                  << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
@@ -128,70 +138,54 @@ void TrainManage::Delete(ParameterTable& input) {
     trainIndex_.Erase(ToHashPair(input['i']));
 #endif // ROLLBACK
 #ifdef PRETTY_PRINT
-    std::cout << "[" << input.TimeStamp() << "] Train " << train.trainID
-              << " has been deleted successfully." << std::endl;
+    output << "[" << input.TimeStamp() << "] Train " << train.trainID
+              << " has been deleted successfully." << ENDL;
 #else
-    std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
+    output << "[" << input.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
 }
 
 void TrainManage::Release(ParameterTable& input) {
     if (!trainIndex_.Contains(ToHashPair(input['i']))) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Release failed: train "
-                  << input['i'] << " does not exist." << std::endl;
+        output << "[" << input.TimeStamp() << "] Release failed: train "
+                  << input['i'] << " does not exist." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
     long position = trainIndex_.Find();
     Train train = trainData_.Get(position);
+    VERIFY_HASH_HIT("train_index", train.trainID == input['i']);
     if (train.released) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Release failed: train "
+        output << "[" << input.TimeStamp() << "] Release failed: train "
                   << train.trainID
                   << " has been released. There no need to release again."
-                  << std::endl;
+                  << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
     train.released = true;
 
-    TrainTicketCount ticketCount;
+    // Only the days on sale are written; the others stay zero, which reads as
+    // no seats left.
 #ifdef ROLLBACK
-    train.ticketData = ticketData_.Add(ticketCount);
-    for (int i = 1; i < train.startDate.day; ++i) {
-        ticketData_.Add(ticketCount);
-    }
-    for (int j = 1; j < train.stationNum; ++j) {
-        ticketCount.remained[j] = train.seatNum;
-    }
+    train.ticketData = ticketData_.Reserve(98);
     for (int i = train.startDate.day; i <= train.endDate.day; ++i) {
-        ticketData_.Add(ticketCount);
+        ticketData_.Place(TicketCountPosition(train.ticketData, i))
+            .seats.Reset(train.stationNum, train.seatNum);
     }
-    for (int i = train.endDate.day + 1; i < 98; ++i) {
-        ticketData_.Add(ticketCount);
-    }
-    for (int i = 1; i < 100; ++i) {
-        ticketCount.remained[i] = ticketCount.remained[i] = -1;
-    }
-    ticketData_.Add(ticketCount); // 98
-    ticketData_.Add(ticketCount); // 99
 #else
+    train.ticketData = ticketData_.Reserve(1);
+    TrainTicketCount& ticketCount = ticketData_.Place(train.ticketData);
     for (int i = train.startDate.day; i <= train.endDate.day; ++i) {
-        for (int j = 1; j < train.stationNum; ++j) {
-            ticketCount.remained[i][j] = train.seatNum;
-        }
-    }
-    for (int i = 1; i < 100; ++i) {
-        ticketCount.remained[98][i] = ticketCount.remained[99][i] = -1;
+        ticketCount.days[i].Reset(train.stationNum, train.seatNum);
     }
-
-    train.ticketData = ticketData_.Add(ticketCount);
 #endif // ROLLBACK
 
     for (int i = 1; i <= train.stationNum; ++i) {
@@ -211,98 +205,89 @@ void TrainManage::Release(ParameterTable& input) {
 #endif // ROLLBACK
 
 #ifdef PRETTY_PRINT
-    std::cout << "[" << input.TimeStamp() << "] Train " << train.trainID
-              << " has been released successfully." << std::endl;
+    output << "[" << input.TimeStamp() << "] Train " << train.trainID
+              << " has been released successfully." << ENDL;
 #else
-    std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
+    output << "[" << input.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
 }
 
 void TrainManage::QueryTrain(ParameterTable& input) {
-    if (!trainIndex_.Contains(ToHashPair(input['i']))) {
+    PhaseTimer timer(Phase::index);
+    long position;
+    if (!trainIndex_.Contains(ToHashPair(input['i']), position)) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Query failed: train "
-                  << input['i'] << " does not exist." << std::endl;
+        output << "[" << input.TimeStamp() << "] Query failed: train "
+                  << input['i'] << " does not exist." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
-    long position = trainIndex_.Find();
+    timer.Switch(Phase::fetch);
     Date date(input['d']);
     int day = date.day;
     Train train = trainData_.Get(position);
+    VERIFY_HASH_HIT("train_index", train.trainID == input['i']);
     if (date < train.startDate || date > train.endDate) {
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
         return;
     }
 
     if (train.released) {
-#ifdef ROLLBACK
-        TrainTicketCount ticketCount = ticketData_.Get(train.ticketData
-            + sizeof(TrainTicketCount) * day);
-#else
-        TrainTicketCount ticketCount = ticketData_.Get(train.ticketData);
-#endif // ROLLBACK
+        const SeatCount& seats
+            = ticketData_.Get(TicketCountPosition(train.ticketData, day)).Day(day);
+        timer.Switch(Phase::output);
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] ID: " << train.trainID
+        output << "[" << input.TimeStamp() << "] ID: " << train.trainID
                   << " type: " << train.type << " total " << train.stationNum
-                  << "stations." << std::endl;
+                  << "stations." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] " << train.trainID << " " << train.type << ENDL;
+        output << "[" << input.TimeStamp() << "] " << train.trainID << " " << train.type << ENDL;
 #endif // PRETTY_PRINT
 
-        std::cout << train.stations[1] << " xx-xx xx:xx -> "
+        output << train.stations[1] << " xx-xx xx:xx -> "
                   << date + train.departureTime[1].minute / 1440 << " "
                   << train.departureTime[1] << " "
                   << train.prefixPriceSum[1] << " "
-#ifdef ROLLBACK
-                  << ticketCount.remained[1]
-#else
-                  << ticketCount.remained[day][1]
-#endif // ROLLBACK
-                  << ENDL;
+                  << seats.Get(1) << ENDL;
         for (int i = 2; i < train.stationNum; ++i) {
-            std::cout << train.stations[i] << " "
+            output << train.stations[i] << " "
                       << date + train.arrivalTime[i].minute / 1440 << " "
                       << train.arrivalTime[i] << " -> "
                       << date + train.departureTime[i].minute / 1440 << " "
                       << train.departureTime[i] << " "
                       << train.prefixPriceSum[i] << " "
-#ifdef ROLLBACK
-                      << ticketCount.remained[i]
-#else
-                      << ticketCount.remained[day][i]
-#endif // ROLLBACK
-                      << ENDL;
+                      << seats.Get(i) << ENDL;
         }
-        std::cout << train.stations[train.stationNum] << " "
+        output << train.stations[train.stationNum] << " "
                   << date + train.arrivalTime[train.stationNum].minute / 1440 << " "
                   << train.arrivalTime[train.stationNum] << " -> xx-xx xx:xx "
                   << train.prefixPriceSum[train.stationNum] << " x" << ENDL;
     } else {
+        timer.Switch(Phase::output);
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] ID: " << train.trainID
+        output << "[" << input.TimeStamp() << "] ID: " << train.trainID
                   << " type: " << train.type << " total " << train.stationNum
-                  << "stations." << std::endl;
+                  << "stations." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] " << train.trainID << " " << train.type << ENDL;
+        output << "[" << input.TimeStamp() << "] " << train.trainID << " " << train.type << ENDL;
 #endif // PRETTY_PRINT
 
-        std::cout << train.stations[1] << " xx-xx xx:xx -> "
+        output << train.stations[1] << " xx-xx xx:xx -> "
                   << date + train.departureTime[1].minute / 1440 << " "
                   << train.departureTime[1] << " "
                   << train.prefixPriceSum[1] << " " << train.seatNum << ENDL;
         for (int i = 2; i < train.stationNum; ++i) {
-            std::cout << train.stations[i] << " "
+            output << train.stations[i] << " "
                       << date + train.arrivalTime[i].minute / 1440 << " "
                       << train.arrivalTime[i] << " -> "
                       << date + train.departureTime[i].minute / 1440 << " "
                       << train.departureTime[i] << " "
                       << train.prefixPriceSum[i] << " " << train.seatNum << ENDL;
         }
-        std::cout << train.stations[train.stationNum] << " "
+        output << train.stations[train.stationNum] << " "
                   << date + train.arrivalTime[train.stationNum].minute / 1440 << " "
                   << train.arrivalTime[train.stationNum] << " -> xx-xx xx:xx "
                   << train.prefixPriceSum[train.stationNum] << " x" << ENDL;
@@ -310,8 +295,10 @@ void TrainManage::QueryTrain(ParameterTable& input) {
 }
 
 void TrainManage::QueryTicket(ParameterTable& input) {
+    PhaseTimer timer(Phase::index);
     auto start = stationIndex_.MultiFind(ToHashPair(input['s']));
     auto end = stationIndex_.MultiFind(ToHashPair(input['t']));
+    timer.Switch(Phase::compute);
     Date date(input['d']);
     LinkedHashMap<long, long> ticketIndex;
     ticketIndex.ReserveAtLeast(512);
@@ -319,39 +306,62 @@ void TrainManage::QueryTicket(ParameterTable& input) {
     for (auto& i : start) {
         ticketIndex[i.first] = i.second;
     }
+    // The trains through both stations in order, and where they stop there.
+    Vector<long> passing;
+    Vector<int> departs, arrives;
     for (auto& i : end) {
         if (ticketIndex.Contains(i.first) && ticketIndex[i.first] < i.second) {
-            Train train = trainData_.Get(i.first);
-            int tmpDate = date.day - train.departureTime[ticketIndex[i.first]].minute / 1440;
+            passing.PushBack(i.first);
+            departs.PushBack(static_cast<int>(ticketIndex[i.first]));
+            arrives.PushBack(static_cast<int>(i.second));
+        }
+    }
+    // The trains, then the seats of those running on the day, are read in
+    // batches rather than one by one.
+    for (long first = 0; first < passing.Size();) {
+        timer.Switch(Phase::fetch);
+        Vector<const Train*> trains = trainData_.GetMany(passing, first);
+        timer.Switch(Phase::compute);
+        Vector<long> running, seats;
+        Vector<int> days;
+        for (long i = 0; i < trains.Size(); ++i) {
+            const Train& train = *trains[i];
+            long k = first + i;
+            VERIFY_HASH_HIT("station_index",
+                            train.stations[departs[k]] == input['s'] &&
+                            train.stations[arrives[k]] == input['t']);
+            int tmpDate = date.day - train.departureTime[departs[k]].minute / 1440;
             if (tmpDate < train.startDate.day || tmpDate > train.endDate.day) {
                 continue;
             }
-#ifdef ROLLBACK
-            TrainTicketCount ticketCount = ticketData_.Get(train.ticketData
-                + sizeof(TrainTicketCount) * tmpDate);
-            int ticketNum = ticketCount.remained[ticketIndex[i.first]];
-            for (int j = ticketIndex[i.first] + 1; j < i.second; ++j) {
-                ticketNum = std::min(ticketNum, ticketCount.remained[j]);
-            }
-#else
-            TrainTicketCount ticketCount = ticketData_.Get(train.ticketData);
-            int ticketNum = ticketCount.remained[tmpDate][ticketIndex[i.first]];
-            for (int j = ticketIndex[i.first] + 1; j < i.second; ++j) {
-                ticketNum = std::min(ticketNum, ticketCount.remained[tmpDate][j]);
+            running.PushBack(i);
+            days.PushBack(tmpDate);
+            seats.PushBack(TicketCountPosition(train.ticketData, tmpDate));
+        }
+        for (long j = 0; j < seats.Size();) {
+            timer.Switch(Phase::fetch);
+            Vector<const TrainTicketCount*> batch = ticketData_.GetMany(seats, j);
+            timer.Switch(Phase::compute);
+            for (auto counts : batch) {
+                const Train& train = *trains[running[j]];
+                long k = first + running[j];
+                int tmpDate = days[j];
+                int ticketNum = counts->Day(tmpDate).Min(departs[k], arrives[k]);
+                Journey journey;
+                journey.trainID = train.trainID;
+                journey.startStation = train.stations[departs[k]];
+                journey.endStation = train.stations[arrives[k]];
+                journey.startDate.day = tmpDate + train.departureTime[departs[k]].minute / 1440;
+                journey.startTime = train.departureTime[departs[k]];
+                journey.endDate.day = tmpDate + train.arrivalTime[arrives[k]].minute / 1440;
+                journey.endTime = train.arrivalTime[arrives[k]];
+                journey.price = train.prefixPriceSum[arrives[k]] - train.prefixPriceSum[departs[k]];
+                journey.seat = ticketNum;
+                journeys.PushBack(journey);
+                ++j;
             }
-#endif // ROLLBACK
-            Journey journey;
-            journey.trainID = train.trainID;
-            journey.startStation = train.stations[ticketIndex[i.first]];
-            journey.endStation = train.stations[i.second];
-            journey.startDate.day = tmpDate + train.departureTime[ticketIndex[i.first]].minute / 1440;
-            journey.startTime = train.departureTime[ticketIndex[i.first]];
-            journey.endDate.day = tmpDate + train.arrivalTime[i.second].minute / 1440;
-            journey.endTime = train.arrivalTime[i.second];
-            journey.price = train.prefixPriceSum[i.second] - train.prefixPriceSum[ticketIndex[i.first]];
-            journey.seat = ticketNum;
-            journeys.PushBack(journey);
         }
+        first += trains.Size();
     }
     if (input['p'].empty() || input['p'][0] == 't') {
         journeys.Sort([](const Journey& a, const Journey& b) {
@@ -368,55 +378,61 @@ void TrainManage::QueryTicket(ParameterTable& input) {
             return a.trainID < b.trainID;
         });
     }
+    timer.Switch(Phase::output);
 #ifdef PRETTY_PRINT
-    std::cout << "[" << input.TimeStamp() << "] " << journeys.Size() << " plans" << ENDL;
+    output << "[" << input.TimeStamp() << "] " << journeys.Size() << " plans" << ENDL;
 #else
-    std::cout << "[" << input.TimeStamp() << "] " << journeys.Size() << ENDL;
+    output << "[" << input.TimeStamp() << "] " << journeys.Size() << ENDL;
 #endif
     for (auto& i : journeys) {
-        std::cout << i << ENDL;
+        output << i << ENDL;
     }
 }
 
 void TrainManage::TryBuy(ParameterTable& input, UserManage& userManage) {
-    if (!userManage.Logged(input['u'])) {
+    SessionId session = userManage.FindSession(input['u']);
+    if (session == kNoSession) {
 #ifdef ROLLBACK
-        std::cout << "[" << input.TimeStamp()
+        output << "[" << input.TimeStamp()
                   << "] Buy failed: user hasn't logged in yet." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // ROLLBACK
         return;
     }
-    if (!trainIndex_.Contains(ToHashPair(input['i']))) {
+    PhaseTimer timer(Phase::index);
+    long position;
+    if (!trainIndex_.Contains(ToHashPair(input['i']), position)) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp()
-                  << "] Buy failed: train doesn't exist." << std::endl;
+        output << "[" << input.TimeStamp()
+                  << "] Buy failed: train doesn't exist." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
-    long position = trainIndex_.Find();
+    timer.Switch(Phase::fetch);
     Train train = trainData_.Get(position);
+    timer.Switch(Phase::compute);
+    VERIFY_HASH_HIT("train_index", train.trainID == input['i']);
     if (!train.released) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp()
-                  << "] Buy failed: train hasn't been released." << std::endl;
+        output << "[" << input.TimeStamp()
+                  << "] Buy failed: train hasn't been released." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
-    int n = StringToInt(input['n']);
+    int n = input.GetInt('n');
     if (n > train.seatNum) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp()
+        output << "[" << input.TimeStamp()
                   << "] Buy failed: the required seat number exceeds the total seat number."
-                  << std::endl;
+                  << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
@@ -430,10 +446,10 @@ void TrainManage::TryBuy(ParameterTable& input, UserManage& userManage) {
     }
     if (departure == 0) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp()
-                  << "] Buy failed: the departure station doesn't exist." << std::endl;
+        output << "[" << input.TimeStamp()
+                  << "] Buy failed: the departure station doesn't exist." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
@@ -444,10 +460,10 @@ void TrainManage::TryBuy(ParameterTable& input, UserManage& userManage) {
     }
     if (arrival == 0) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp()
-                  << "] Buy failed: the arrival station doesn't exist." << std::endl;
+        output << "[" << input.TimeStamp()
+                  << "] Buy failed: the arrival station doesn't exist." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
@@ -458,46 +474,29 @@ void TrainManage::TryBuy(ParameterTable& input, UserManage& userManage) {
 
     if (trainDate < train.startDate || trainDate > train.endDate) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp()
+        output << "[" << input.TimeStamp()
                   << "] Buy failed: the train doesn't run on the required date."
-                  << std::endl;
+                  << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
     // Now there exist a train that can serve the request
-#ifdef ROLLBACK
-    TrainTicketCount ticketCount = ticketData_.Get(train.ticketData
-        + sizeof(TrainTicketCount) * trainDate.day);
-    int ticketNum = ticketCount.remained[departure];
-    for (int i = departure + 1; i < arrival; ++i) {
-        ticketNum = std::min(ticketNum, ticketCount.remained[i]);
-    }
-#else
-    TrainTicketCount ticketCount = ticketData_.Get(train.ticketData);
-    int ticketNum = ticketCount.remained[trainDate.day][departure];
-    for (int i = departure + 1; i < arrival; ++i) {
-        ticketNum = std::min(ticketNum, ticketCount.remained[trainDate.day][i]);
-    }
-#endif // ROLLBACK
+    long countPosition = TicketCountPosition(train.ticketData, trainDate.day);
 
     // the process of purchasing
-    if (ticketNum >= n) { // Enough ticket(s)
+    timer.Switch(Phase::fetch);
+    if (ticketData_.Get(countPosition).Day(trainDate.day).AllAtLeast(departure, arrival, n)) {
+        TrainTicketCount ticketCount = ticketData_.Get(countPosition);
+        ticketCount.Day(trainDate.day).Add(departure, arrival, -n);
 #ifdef ROLLBACK
-        for (int i = departure; i < arrival; ++i) {
-            ticketCount.remained[i] -= n;
-        }
-        ticketData_.Modify(train.ticketData + sizeof(TrainTicketCount) * trainDate.day,
-                           ticketCount,
-                           input.TimeStamp());
+        ticketData_.Modify(countPosition, ticketCount, input.TimeStamp());
 #else
-        for (int i = departure; i < arrival; ++i) {
-            ticketCount.remained[trainDate.day][i] -= n;
-        }
-        ticketData_.Modify(train.ticketData, ticketCount);
+        ticketData_.Modify(countPosition, ticketCount);
 #endif // ROLLBACK
+        timer.Switch(Phase::compute);
         Ticket ticket;
         ticket.trainID = train.trainID;
         ticket.startStation = train.stations[departure];
@@ -514,20 +513,23 @@ void TrainManage::TryBuy(ParameterTable& input, UserManage& userManage) {
         ticket.to = arrival;
         ticket.state = TicketState::bought;
         ticket.seatNum = n;
-        userManage.AddOrder(input['u'], ticket, input.TimeStamp(), *this);
+        ticket.timeStamp = input.TimeStamp();
+        userManage.AddOrder(session, ticket, input.TimeStamp(), *this);
+        timer.Switch(Phase::output);
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Price: " << ticket.price * n << std::endl;
+        output << "[" << input.TimeStamp() << "] Price: " << ticket.price * n << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] " << ticket.price * n << ENDL;
+        output << "[" << input.TimeStamp() << "] " << ticket.price * n << ENDL;
 #endif // PRETTY_PRINT
     } else {
+        timer.Switch(Phase::compute);
         if (input['q'].empty() || input['q'][0] == 'f') {
 #ifdef PRETTY_PRINT
-            std::cout << "[" << input.TimeStamp()
+            output << "[" << input.TimeStamp()
                       << "] Buy failed: the required seat number exceeds the number of available seats."
-                      << std::endl;
+                      << ENDL;
 #else
-            std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+            output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         } else {
             Ticket ticket;
@@ -546,79 +548,63 @@ void TrainManage::TryBuy(ParameterTable& input, UserManage& userManage) {
             ticket.to = arrival;
             ticket.state = TicketState::pending;
             ticket.seatNum = n;
+            ticket.timeStamp = input.TimeStamp();
+            long orderPosition = userManage.AddOrder(session, ticket, input.TimeStamp(), *this);
+            PendingKey key{position, trainDate.day, input.TimeStamp(), orderPosition};
+            PendingOrder order{orderPosition, departure, arrival, n};
+            timer.Switch(Phase::index);
 #ifdef ROLLBACK
-            ticketCount = ticketData_.Get(train.ticketData
-                + sizeof(TrainTicketCount) * 99);
-            if (ticketCount.remained[trainDate.day] != -1) {
-                long lastQueuePtr = ticketCount.remained[trainDate.day];
-                Ticket lastQueue = userTicketData_.Get(lastQueuePtr);
-                lastQueue.queue = userManage.AddOrder(input['u'], ticket, input.TimeStamp(), *this);
-                userTicketData_.Modify(lastQueuePtr, lastQueue, input.TimeStamp());
-                ticketCount.remained[trainDate.day] = lastQueue.queue;
-                ticketData_.Modify(train.ticketData + sizeof(TrainTicketCount) * 99,
-                                   ticketCount,
-                                   input.TimeStamp());
-            } else {
-                int ptr = userManage.AddOrder(input['u'], ticket, input.TimeStamp(), *this);
-                ticketCount.remained[trainDate.day] = ptr;
-                ticketData_.Modify(train.ticketData + sizeof(TrainTicketCount) * 99,
-                                   ticketCount,
-                                   input.TimeStamp());
-                ticketCount = ticketData_.Get(train.ticketData
-                                              + sizeof(TrainTicketCount) * 98);
-                ticketCount.remained[trainDate.day] = ptr;
-                ticketData_.Modify(train.ticketData + sizeof(TrainTicketCount) * 98,
-                                   ticketCount,
-                                   input.TimeStamp());
-            }
+            pendingIndex_.Insert(key, order, input.TimeStamp());
 #else
-            if (ticketCount.remained[99][trainDate.day] != -1) {
-                long lastQueuePtr = ticketCount.remained[99][trainDate.day];
-                Ticket lastQueue = userTicketData_.Get(lastQueuePtr);
-                lastQueue.queue = userManage.AddOrder(input['u'], ticket, input.TimeStamp(), *this);
-                userTicketData_.Modify(lastQueuePtr, lastQueue);
-                ticketCount.remained[99][trainDate.day] = lastQueue.queue;
-            } else {
-                ticketCount.remained[99][trainDate.day]
-                    = userManage.AddOrder(input['u'], ticket, input.TimeStamp(), *this);
-                ticketCount.remained[98][trainDate.day] = ticketCount.remained[99][trainDate.day];
-            }
-            ticketData_.Modify(train.ticketData, ticketCount);
+            pendingIndex_.Insert(key, order);
 #endif // ROLLBACK
+            timer.Switch(Phase::output);
 #ifdef PRETTY_PRINT
-            std::cout << "[" << input.TimeStamp() << "] You are in the pending queue." << ENDL;
+            output << "[" << input.TimeStamp() << "] You are in the pending queue." << ENDL;
 #else
-            std::cout << "[" << input.TimeStamp() << "] queue" << ENDL;
+            output << "[" << input.TimeStamp() << "] queue" << ENDL;
 #endif // PRETTY_PRINT
         }
     }
 
 }
 
-long TrainManage::AddOrder(Ticket& ticket, long timeStamp) {
-    return userTicketData_.Add(ticket);
+long TrainManage::AddOrder(Ticket& ticket, const OrderKey& key, long timeStamp) {
+    PhaseTimer timer(Phase::fetch);
+    long position = userTicketData_.Add(ticket);
+    timer.Switch(Phase::index);
+#ifdef ROLLBACK
+    orderIndex_.Insert(key, position, timeStamp);
+#else
+    orderIndex_.Insert(key, position);
+#endif // ROLLBACK
+    return position;
 }
 
 void TrainManage::QueryOrder(ParameterTable& input, UserManage& userManage) {
-    if (!userManage.Logged(input['u'])) {
+    SessionId session = userManage.FindSession(input['u']);
+    if (session == kNoSession) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Query failed: the user hasn't logged in yet."
-                  << std::endl;
+        output << "[" << input.TimeStamp() << "] Query failed: the user hasn't logged in yet."
+                  << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
-    long OrderPtr = userManage.GetUser(input['u']).orderInfo;
-    Vector<Ticket> tickets;
-    while (OrderPtr != -1) {
-        tickets.PushBack(userTicketData_.Get(OrderPtr));
-        OrderPtr = tickets.Back().last;
-    }
-    std::cout << "[" << input.TimeStamp() << "] " << tickets.Size() << ENDL;
-    for (auto& i : tickets) {
-        std::cout << i << ENDL;
+    // The orders of a user are adjacent in the order index, oldest first.
+    const Session& login = userManage.GetSession(session);
+    PhaseTimer timer(Phase::index);
+    Vector<long> orders = orderIndex_.RangeFind(OrderKey(login.userHash, 1),
+        OrderKey(login.userHash, login.user.orderCount));
+    timer.Switch(Phase::output);
+    output << "[" << input.TimeStamp() << "] " << orders.Size() << ENDL;
+    for (long i = static_cast<long>(orders.Size()) - 1; i >= 0; --i) {
+        timer.Switch(Phase::fetch);
+        const Ticket& ticket = userTicketData_.Get(orders[i]);
+        timer.Switch(Phase::output);
+        output << ticket << ENDL;
     }
 }
 
@@ -628,230 +614,185 @@ void TrainManage::Clear() {
     ticketData_.Clear();
     userTicketData_.Clear();
     stationIndex_.Clear();
+    orderIndex_.Clear();
+    pendingIndex_.Clear();
+}
+
+void TrainManage::WarmUp(bool preload) {
+    trainIndex_.WarmUp(preload);
+    trainData_.WarmUp(preload);
+    ticketData_.WarmUp(preload);
+    stationIndex_.WarmUp(preload);
+    userTicketData_.WarmUp(preload);
+    orderIndex_.WarmUp(preload);
+    pendingIndex_.WarmUp(preload);
 }
 
+#ifndef ROLLBACK
+void TrainManage::Compact() {
+    trainIndex_.Compact();
+    stationIndex_.Compact();
+    orderIndex_.Compact();
+    pendingIndex_.Compact();
+    // The records of these files are pointed to from the indexes, so they
+    // cannot move; only their free tails go.
+    trainData_.Trim();
+    ticketData_.Trim();
+    userTicketData_.Trim();
+}
+#endif // ROLLBACK
+
 void TrainManage::Refund(ParameterTable& input, UserManage& userManage) {
-    if (!userManage.Logged(input['u'])) {
+    SessionId session = userManage.FindSession(input['u']);
+    if (session == kNoSession) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Refund failed: the user hasn't logged in yet."
-                  << std::endl;
+        output << "[" << input.TimeStamp() << "] Refund failed: the user hasn't logged in yet."
+                  << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
-    // Get the pointer to the order
-    long orderPtr = userManage.GetUser(input['u']).orderInfo;
-    if (orderPtr == -1) {
+    // Get the pointer to the order; -n counts from the latest order
+    int number = input['n'].empty() ? 1 : std::max(input.GetInt('n'), 1);
+    const Session& login = userManage.GetSession(session);
+    int orderCount = login.user.orderCount;
+    PhaseTimer timer(Phase::index);
+    long orderPtr;
+    if (number > orderCount
+        || !orderIndex_.Contains(OrderKey(login.userHash, orderCount - number + 1), orderPtr)) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Refund failed: no such order."
-                  << std::endl;
+        output << "[" << input.TimeStamp() << "] Refund failed: no such order."
+                  << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
-    int number;
-    if (input['n'].empty()) number = 0;
-    else number = StringToInt(input['n']) - 1;
-    Ticket ticket;
-    ticket = userTicketData_.Get(orderPtr);
-    while (number > 0) {
-        orderPtr = ticket.last;
-        if (orderPtr == -1) {
-#ifdef PRETTY_PRINT
-            std::cout << "[" << input.TimeStamp() << "] Refund failed: no such order."
-                      << std::endl;
-#else
-            std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
-#endif // PRETTY_PRINT
-            return;
-        }
-        ticket = userTicketData_.Get(orderPtr);
-        --number;
-    }
+    timer.Switch(Phase::fetch);
+    Ticket ticket = userTicketData_.Get(orderPtr);
+    timer.Switch(Phase::compute);
 
     // Refund the ticket
     if (ticket.state == TicketState::refunded) { // has already refunded
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Refund failed: the ticket has already been refunded."
-                  << std::endl;
+        output << "[" << input.TimeStamp() << "] Refund failed: the ticket has already been refunded."
+                  << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
     if (ticket.state == TicketState::pending) { // in the pending list, not need to modify the train data
         ticket.state = TicketState::refunded;
+        PendingKey key{ticket.trainPosition, ticket.index, ticket.timeStamp, orderPtr};
+        timer.Switch(Phase::fetch);
 #ifdef ROLLBACK
         userTicketData_.Modify(orderPtr, ticket, input.TimeStamp());
 #else
         userTicketData_.Modify(orderPtr, ticket);
 #endif // ROLLBACK
+        timer.Switch(Phase::index);
+#ifdef ROLLBACK
+        pendingIndex_.Erase(key, input.TimeStamp());
+#else
+        pendingIndex_.Erase(key);
+#endif // ROLLBACK
+        timer.Switch(Phase::output);
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Refund successfully." << std::endl;
+        output << "[" << input.TimeStamp() << "] Refund successfully." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
+        output << "[" << input.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
 
         return;
     }
     ticket.state = TicketState::refunded;
+    timer.Switch(Phase::fetch);
 #ifdef ROLLBACK
     userTicketData_.Modify(orderPtr, ticket, input.TimeStamp());
-    TrainTicketCount ticketCount = ticketData_.Get(ticket.ticketPosition
-        + sizeof(TrainTicketCount) * ticket.index);
-    for (int i = ticket.from; i < ticket.to; ++i) {
-        ticketCount.remained[i] += ticket.seatNum;
-    }
 #else
     userTicketData_.Modify(orderPtr, ticket);
-    TrainTicketCount ticketCount = ticketData_.Get(ticket.ticketPosition);
-    for (int i = ticket.from; i < ticket.to; ++i) {
-        ticketCount.remained[ticket.index][i] += ticket.seatNum;
-    }
 #endif // ROLLBACK
-
-    // check the pending queue
-#ifdef ROLLBACK
-    TrainTicketCount head = ticketData_.Get(ticket.ticketPosition
-        + sizeof(TrainTicketCount) * 98);
-    long queuePtr = head.remained[ticket.index];
-    TrainTicketCount tail = ticketData_.Get(ticket.ticketPosition
-        + sizeof(TrainTicketCount) * 99);
-#else
-    long queuePtr = ticketCount.remained[98][ticket.index];
-#endif // ROLLBACK
-    long nextPtr;
-    // Nothing to pend
-    if (queuePtr == -1) {
-#ifdef ROLLBACK
-        ticketData_.Modify(ticket.ticketPosition + sizeof(TrainTicketCount) * ticket.index,
-                           ticketCount,
-                           input.TimeStamp());
-#else
-        ticketData_.Modify(ticket.ticketPosition, ticketCount);
-#endif // ROLLBACK
-#ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Refund successfully." << std::endl;
-#else
-        std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
-#endif // PRETTY_PRINT
-        return;
-    }
-    ticket = userTicketData_.Get(queuePtr);
-
-    // the case that the head nodes can be served
-    while (ticket.state == TicketState::pending &&
-           CanBuyTicket(ticketCount, ticket.index, ticket.from, ticket.to, ticket.seatNum)) {
-        ticket.state = TicketState::bought;
-        nextPtr = ticket.queue;
-        ticket.queue = -1;
-#ifdef ROLLBACK
-        userTicketData_.Modify(queuePtr, ticket, input.TimeStamp());
-        for (int i = ticket.from; i < ticket.to; ++i) {
-            ticketCount.remained[i] -= ticket.seatNum;
+    long countPosition = TicketCountPosition(ticket.ticketPosition, ticket.index);
+    TrainTicketCount ticketCount = ticketData_.Get(countPosition);
+    timer.Switch(Phase::compute);
+    SeatCount& seats = ticketCount.Day(ticket.index);
+    seats.Add(ticket.from, ticket.to, ticket.seatNum);
+
+    // Serve the pending orders of the day in FIFO order.  Every pending order
+    // was unsatisfiable before this refund, so only those needing a station
+    // in [from, to) can have become satisfiable; the others are skipped
+    // without reading their tickets.
+    timer.Switch(Phase::index);
+    Vector<PendingOrder> pending = pendingIndex_.RangeFind(
+        PendingKey{ticket.trainPosition, ticket.index, std::numeric_limits<long>::min(),
+                   std::numeric_limits<long>::min()},
+        PendingKey{ticket.trainPosition, ticket.index, std::numeric_limits<long>::max(),
+                   std::numeric_limits<long>::max()});
+    timer.Switch(Phase::compute);
+    for (auto& order : pending) {
+        if (order.from >= ticket.to || order.to <= ticket.from
+            || !seats.AllAtLeast(order.from, order.to, order.seatNum)) {
+            continue;
         }
-#else
-        userTicketData_.Modify(queuePtr, ticket);
-        for (int i = ticket.from; i < ticket.to; ++i) {
-            ticketCount.remained[ticket.index][i] -= ticket.seatNum;
+        timer.Switch(Phase::fetch);
+        Ticket served = userTicketData_.Get(order.ticket);
+        if (served.state != TicketState::pending) { // a stale entry, never serve it twice
+            timer.Switch(Phase::compute);
+            continue;
         }
-#endif // ROLLBACK
-        queuePtr = nextPtr;
-        if (queuePtr == -1) {
+        served.state = TicketState::bought;
+        PendingKey key{served.trainPosition, served.index, served.timeStamp, order.ticket};
 #ifdef ROLLBACK
-            head.remained[ticket.index] = -1;
-            tail.remained[ticket.index] = -1;
-            ticketData_.Modify(ticket.ticketPosition + sizeof(TrainTicketCount) * ticket.index,
-                               ticketCount,
-                               input.TimeStamp());
-            ticketData_.Modify(ticket.ticketPosition + sizeof(TrainTicketCount) * 98,
-                               head,
-                               input.TimeStamp());
-            ticketData_.Modify(ticket.ticketPosition + sizeof(TrainTicketCount) * 99,
-                               tail,
-                               input.TimeStamp());
+        userTicketData_.Modify(order.ticket, served, input.TimeStamp());
+        timer.Switch(Phase::index);
+        pendingIndex_.Erase(key, input.TimeStamp());
 #else
-            ticketCount.remained[98][ticket.index] = -1;
-            ticketCount.remained[99][ticket.index] = -1;
-            ticketData_.Modify(ticket.ticketPosition, ticketCount);
+        userTicketData_.Modify(order.ticket, served);
+        timer.Switch(Phase::index);
+        pendingIndex_.Erase(key);
 #endif // ROLLBACK
-#ifdef PRETTY_PRINT
-            std::cout << "[" << input.TimeStamp() << "] Refund successfully." << std::endl;
-#else
-            std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
-#endif // PRETTY_PRINT
-            return;
-        }
-        ticket = userTicketData_.Get(queuePtr);
+        timer.Switch(Phase::compute);
+        seats.Add(order.from, order.to, -order.seatNum);
     }
-#ifdef ROLLBACK
-    head.remained[ticket.index] = queuePtr;
-#else
-    ticketCount.remained[98][ticket.index] = queuePtr;
-#endif // ROLLBACK
 
-    // this node cannot be served, so we need to move to the next node
-    long lastPtr = queuePtr;
-    queuePtr = ticket.queue;
-
-    while (queuePtr != -1) {
-        ticket = userTicketData_.Get(queuePtr);
-        if (ticket.state == TicketState::pending &&
-            CanBuyTicket(ticketCount, ticket.index, ticket.from, ticket.to, ticket.seatNum)) {
-            ticket.state = TicketState::bought;
-            nextPtr = ticket.queue;
-            ticket.queue = -1;
-#ifdef ROLLBACK
-            userTicketData_.Modify(queuePtr, ticket, input.TimeStamp());
-#else
-            userTicketData_.Modify(queuePtr, ticket);
-#endif // ROLLBACK
-            for (int i = ticket.from; i < ticket.to; ++i) {
+    timer.Switch(Phase::fetch);
 #ifdef ROLLBACK
-                ticketCount.remained[i] -= ticket.seatNum;
+    ticketData_.Modify(countPosition, ticketCount, input.TimeStamp());
 #else
-                ticketCount.remained[ticket.index][i] -= ticket.seatNum;
-#endif // ROLLBACK
-            }
-            queuePtr = nextPtr;
-        } else {
-            Ticket lastTicket = userTicketData_.Get(lastPtr);
-            lastTicket.queue = queuePtr;
-#ifdef ROLLBACK
-            userTicketData_.Modify(lastPtr, lastTicket, input.TimeStamp());
-#else
-            userTicketData_.Modify(lastPtr, lastTicket);
-#endif // ROLLBACK
-            lastPtr = queuePtr;
-            queuePtr = ticket.queue;
-        }
-    }
-
-#ifdef ROLLBACK
-    tail.remained[ticket.index] = lastPtr;
-    ticketData_.Modify(ticket.ticketPosition + sizeof(TrainTicketCount) * ticket.index,
-                       ticketCount,
-                       input.TimeStamp());
-    ticketData_.Modify(ticket.ticketPosition + sizeof(TrainTicketCount) * 98,
-                       head,
-                       input.TimeStamp());
-    ticketData_.Modify(ticket.ticketPosition + sizeof(TrainTicketCount) * 99,
-                       tail,
-                       input.TimeStamp());
-#else
-    ticketCount.remained[99][ticket.index] = lastPtr;
-    ticketData_.Modify(ticket.ticketPosition, ticketCount);
+    ticketData_.Modify(countPosition, ticketCount);
 #endif // ROLLBACK
+    timer.Switch(Phase::output);
 #ifdef PRETTY_PRINT
-    std::cout << "[" << input.TimeStamp() << "] Refund successfully." << std::endl;
+    output << "[" << input.TimeStamp() << "] Refund successfully." << ENDL;
 #else
-    std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
+    output << "[" << input.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
 }
 
+#ifndef ROLLBACK
+long TrainManage::TrainOf(ParameterTable& input, UserManage& userManage) {
+    long position;
+    if (input.GetCommand() == Command::buyTicket) {
+        return trainIndex_.Contains(ToHashPair(input['i']), position) ? position : -1;
+    }
+    SessionId session = userManage.FindSession(input['u']);
+    if (session == kNoSession) {
+        return -1;
+    }
+    int number = input['n'].empty() ? 1 : std::max(input.GetInt('n'), 1);
+    const Session& login = userManage.GetSession(session);
+    int orderCount = login.user.orderCount;
+    if (number > orderCount
+        || !orderIndex_.Contains(OrderKey(login.userHash, orderCount - number + 1), position)) {
+        return -1;
+    }
+    return userTicketData_.Get(position).trainPosition;
+}
+#endif
+
 void TrainManage::QueryTransfer(ParameterTable& input) {
     Vector<Train> trains; // train2
     bool Found = false;
@@ -860,48 +801,63 @@ void TrainManage::QueryTransfer(ParameterTable& input) {
     Vector<HashPair> stationHash;
     stationHash.Resize(101);
 
+    PhaseTimer timer(Phase::index);
     auto start = stationIndex_.MultiFind(ToHashPair(input['s']));
     auto end = stationIndex_.MultiFind(ToHashPair(input['t']));
+    timer.Switch(Phase::compute);
     Date date(input['d']);
     bool rule; // true for time, false for cost
     if (input['p'].empty() || input['p'][0] == 't') rule = true;
     else rule = false;
 
+    // The trains at either end, read in batches.
+    Vector<long> startTrains, endTrains;
+    for (auto& i : start) startTrains.PushBack(i.first);
+    for (auto& i : end) endTrains.PushBack(i.first);
+
     auto* stations2 = new LinkedHashMap<HashPair, long, HashPairHash>[end.Size()];
-    for (int i = 0; i < end.Size(); ++i) {
-        trains.PushBack(trainData_.Get(end[i].first));
-        for (int j = 1; j < end[i].second; ++j) {
-            stations2[i][ToHashPair(trains.Back().stations[j])] = j;
+    for (int i = 0; i < end.Size();) {
+        timer.Switch(Phase::fetch);
+        Vector<const Train*> endBatch = trainData_.GetMany(endTrains, i);
+        timer.Switch(Phase::compute);
+        for (auto train : endBatch) {
+            trains.PushBack(*train);
+            VERIFY_HASH_HIT("station_index", trains.Back().stations[end[i].second] == input['t']);
+            for (int j = 1; j < end[i].second; ++j) {
+                stations2[i][ToHashPair(trains.Back().stations[j])] = j;
+            }
+            ++i;
         }
     }
 
-    for (auto& startPtr : start) {
-        Train train1 = trainData_.Get(startPtr.first);
+    Vector<const Train*> trains1;
+    long batch = 0; // the index in start of trains1[0]
+    for (long i = 0; i < start.Size(); ++i) {
+        auto& startPtr = start[i];
+        if (i == batch + trains1.Size()) {
+            batch = i;
+            timer.Switch(Phase::fetch);
+            trains1 = trainData_.GetMany(startTrains, i);
+            timer.Switch(Phase::compute);
+        }
+        const Train& train1 = *trains1[i - batch];
+        VERIFY_HASH_HIT("station_index", train1.stations[startPtr.second] == input['s']);
         int tmpDate = date.day - train1.departureTime[startPtr.second].minute / 1440;
         if (tmpDate < train1.startDate.day || tmpDate > train1.endDate.day) continue;
         int startDate = date.day - train1.departureTime[startPtr.second].minute / 1440;
-#ifdef ROLLBACK
-        TrainTicketCount ticketCount1 = ticketData_.Get(train1.ticketData + sizeof(TrainTicketCount) * startDate);
-#else
-        TrainTicketCount ticketCount1 = ticketData_.Get(train1.ticketData);
-#endif // ROLLBACK
+        timer.Switch(Phase::fetch);
+        SeatCount seats1 = ticketData_.Get(TicketCountPosition(train1.ticketData, startDate))
+            .Day(startDate);
+        timer.Switch(Phase::compute);
 
         for (int j = startPtr.second + 1; j <= train1.stationNum; ++j) {
             stationHash[j] = ToHashPair(train1.stations[j]);
         }
         for (int train2 = 0; train2 < end.Size(); ++train2) {
             if (end[train2].first == startPtr.first) continue; // eliminate the same train
-#ifdef ROLLBACK
-            int remained1 = ticketCount1.remained[startPtr.second];
-#else
-            int remained1 = ticketCount1.remained[startDate][startPtr.second];
-#endif // ROLLBACK
+            int remained1 = seats1.Get(startPtr.second);
             for (int j = startPtr.second + 1; j <= train1.stationNum; ++j) {
-#ifdef ROLLBACK
-                remained1 = std::min(remained1, ticketCount1.remained[j - 1]);
-#else
-                remained1 = std::min(remained1, ticketCount1.remained[startDate][j - 1]);
-#endif // ROLLBACK
+                remained1 = std::min(remained1, seats1.Get(j - 1));
                 if (!stations2[train2].Contains(stationHash[j])) continue;
                 int stationIndex2 = stations2[train2][stationHash[j]];
                 int arrivalDay1 = date.day - train1.departureTime[startPtr.second].minute / 1440
@@ -1003,37 +959,28 @@ void TrainManage::QueryTransfer(ParameterTable& input) {
                 journey2.price = trains[train2].prefixPriceSum[end[train2].second]
                                  - trains[train2].prefixPriceSum[stationIndex2];
                 int index2 = journey2.startDate.day - trains[train2].departureTime[stationIndex2].minute / 1440;
-#ifdef ROLLBACK
-                TrainTicketCount ticketCount2 = ticketData_.Get(trains[train2].ticketData
-                    + sizeof(TrainTicketCount) * index2);
-                journey2.seat = ticketCount2.remained[stationIndex2];
-                for (int k = stationIndex2 + 1; k < end[train2].second; ++k) {
-                    journey2.seat = std::min(journey2.seat, ticketCount2.remained[k]);
-                }
-#else
-                TrainTicketCount ticketCount2 = ticketData_.Get(trains[train2].ticketData);
-                journey2.seat = ticketCount2.remained[index2][stationIndex2];
-                for (int k = stationIndex2 + 1; k < end[train2].second; ++k) {
-                    journey2.seat = std::min(journey2.seat, ticketCount2.remained[index2][k]);
-                }
-#endif // ROLLBACK
+                timer.Switch(Phase::fetch);
+                journey2.seat = ticketData_.Get(TicketCountPosition(trains[train2].ticketData, index2))
+                    .Day(index2).Min(stationIndex2, end[train2].second);
+                timer.Switch(Phase::compute);
 
             }
         }
     }
     delete[] stations2;
 
+    timer.Switch(Phase::output);
     if (Found) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Transfer plan" << std::endl
-                  << journey1 << std::endl
-                  << journey2 << std::endl;
+        output << "[" << input.TimeStamp() << "] Transfer plan" << ENDL
+                  << journey1 << ENDL
+                  << journey2 << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] " << journey1 << ENDL
+        output << "[" << input.TimeStamp() << "] " << journey1 << ENDL
                   << journey2 << ENDL;
 #endif // PRETTY_PRINT
     } else {
-        std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
+        output << "[" << input.TimeStamp() << "] 0" << ENDL;
     }
 }
 
@@ -1044,5 +991,7 @@ void TrainManage::RollBack(long timeStamp) {
     ticketData_.RollBack(timeStamp);
     stationIndex_.RollBack(timeStamp);
     userTicketData_.RollBack(timeStamp);
+    orderIndex_.RollBack(timeStamp);
+    pendingIndex_.RollBack(timeStamp);
 }
 #endif // ROLLBACK
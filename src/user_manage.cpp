@@ -17,50 +17,64 @@
 #include "user_manage.h"
 
 #include "fixed_string.h"
+#include "hash.h"
+#include "stats.h"
 #include "user.h"
 #include "utility.h"
 #include "train.h"
 #include "train_manage.h"
 
-bool LoginPool::Contains(const std::string& name) {
-    return loginUserMap_.Contains(static_cast<FixedString<20>>(name));
+SessionId LoginPool::Login(const User& user, long position) {
+    SessionId id;
+    if (freeSlots_.Empty()) {
+        id = static_cast<SessionId>(sessions_.Size());
+        sessions_.PushBack(Session());
+    } else {
+        id = freeSlots_.Back();
+        freeSlots_.PopBack();
+    }
+    sessions_[id].user = user;
+    sessions_[id].position = position;
+    sessions_[id].userHash = ToHashPair(user.userName);
+    sessionIds_[user.userName] = id;
+    return id;
 }
 
-bool LoginPool::Contains(const FixedString<20>& name) {
-    return loginUserMap_.Contains(name);
+void LoginPool::Logout(SessionId id) {
+    sessionIds_.Erase(sessionIds_.Find(sessions_[id].user.userName));
+    freeSlots_.PushBack(id);
 }
 
-const User& LoginPool::GetData(const FixedString<20>& name) {
-    return loginUserMap_[name];
+SessionId LoginPool::Find(std::string_view name) {
+    auto iter = sessionIds_.Find(static_cast<UserName>(name));
+    return iter == sessionIds_.end() ? kNoSession : iter->second;
 }
 
-const User& LoginPool::GetData(const std::string& name) {
-    return loginUserMap_[static_cast<FixedString<20>>(name)];
+bool LoginPool::Contains(std::string_view name) {
+    return Find(name) != kNoSession;
 }
 
-void LoginPool::Clear() {
-    loginUserMap_.Clear();
+Session& LoginPool::operator[](SessionId id) {
+    return sessions_[id];
 }
 
-bool LoginPool::Empty() {
-    return loginUserMap_.Empty();
-}
-
-void LoginPool::Login(const User& user) {
-    loginUserMap_[user.userName] = user;
+void LoginPool::Clear() {
+    sessionIds_.Clear();
+    sessions_.Clear();
+    freeSlots_.Clear();
 }
 
-void LoginPool::Logout(const UserName& userName) {
-    loginUserMap_.Erase(loginUserMap_.Find(userName));
+SessionId LoginPool::SlotCount() const {
+    return static_cast<SessionId>(sessions_.Size());
 }
 
-void LoginPool::ModifyProfile(const User& user) {
-    loginUserMap_[user.userName] = user;
+bool LoginPool::Empty() {
+    return sessionIds_.Empty();
 }
 
 void UserManage::AddUser(ParameterTable& input) {
     User user;
-    user.privilege = StringToInt(input['g']);
+    user.privilege = input.GetInt('g');
     if (userIndex_.Empty()) {
         user.userName = input['u'];
         user.password = ToHashPair(input['p']);
@@ -69,57 +83,64 @@ void UserManage::AddUser(ParameterTable& input) {
         user.privilege = 10;
         Adduser_(user, input.TimeStamp());
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] User "
-                  << user.userName << " added successfully." << std::endl;
+        output << "[" << input.TimeStamp() << "] User "
+                  << user.userName << " added successfully." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
+        output << "[" << input.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
-    if (!loginPool_.Contains(input['c'])) {
+    SessionId operatorSession = loginPool_.Find(input['c']);
+    if (operatorSession == kNoSession) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Add failed: user "
-                  << input['c'] << " hasn't logged in yet." << std::endl;
+        output << "[" << input.TimeStamp() << "] Add failed: user "
+                  << input['c'] << " hasn't logged in yet." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
-    if (user.privilege >= loginPool_.GetData(input['c']).privilege) {
+    if (user.privilege >= loginPool_[operatorSession].user.privilege) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Add failed: unauthorized operation." << std::endl;
+        output << "[" << input.TimeStamp() << "] Add failed: unauthorized operation." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
+    PhaseTimer timer(Phase::index);
     if (userIndex_.Contains(ToHashPair(input['u']))) {
+        VERIFY_HASH_HIT("user_index", userData_.Get(userIndex_.Find()).userName == input['u']);
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Add failed: user "
-                  << input['u'] << " already exists." << std::endl;
+        output << "[" << input.TimeStamp() << "] Add failed: user "
+                  << input['u'] << " already exists." << ENDL;
 #else
-        std::cout << "[" << input.TimeStamp() << "] -1" << ENDL;
+        output << "[" << input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
+    timer.Switch(Phase::compute);
     user.userName = input['u'];
     user.password = ToHashPair(input['p']);
     user.name = input['n'];
     user.mailAddress = input['m'];
     Adduser_(user, input.TimeStamp());
 
+    timer.Switch(Phase::output);
 #ifdef PRETTY_PRINT
-    std::cout << "[" << input.TimeStamp() << "] User "
-              << user.userName << " added successfully." << std::endl;
+    output << "[" << input.TimeStamp() << "] User "
+              << user.userName << " added successfully." << ENDL;
 #else
-    std::cout << "[" << input.TimeStamp() << "] 0" << ENDL;
+    output << "[" << input.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
 }
 
 void UserManage::Adduser_(User& user, long timeStamp) {
+    PhaseTimer timer(Phase::fetch);
     long position = userData_.Add(user);
+    timer.Switch(Phase::index);
 #ifdef ROLLBACK
     userIndex_.Insert(ToHashPair(user.userName), position, timeStamp);
 #else
@@ -131,161 +152,179 @@ void UserManage::Login(ParameterTable& input) {
 #ifndef GUI
     if (loginPool_.Contains(input['u'])) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Login failed: user "
-                  << input['u'] << " has already logged in." << std::endl;
+        output << "[" << input.TimeStamp() << "] Login failed: user "
+                  << input['u'] << " has already logged in." << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 #endif // GUI
 
+    PhaseTimer timer(Phase::index);
     if (!userIndex_.Contains(ToHashPair(input['u']))) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Login failed: user "
-                  << input['u'] << " doesn't exist." << std::endl;
+        output << "[" << input.TimeStamp() << "] Login failed: user "
+                  << input['u'] << " doesn't exist." << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
     long position = userIndex_.Find();
+    timer.Switch(Phase::fetch);
     User user = userData_.Get(position);
+    timer.Switch(Phase::compute);
+    VERIFY_HASH_HIT("user_index", user.userName == input['u']);
     if (user.password != ToHashPair(input['p'])) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Login failed: incorrect password."
-                  << std::endl;
+        output << "[" << input.TimeStamp() << "] Login failed: incorrect password."
+                  << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 #ifdef GUI
     if (loginPool_.Contains(input['u'])) {
-        std::cout << "[" << input.TimeStamp()
+        output << "[" << input.TimeStamp()
                   << "] Login failed: the user has already logged in."
-                  << std::endl;
+                  << ENDL;
         return;
     }
 #endif // GUI
-    loginPool_.Login(user);
+    loginPool_.Login(user, position);
+    timer.Switch(Phase::output);
 #ifdef PRETTY_PRINT
-    std::cout << "[" << input.TimeStamp() << "] Login successfully." << std::endl;
+    output << "[" << input.TimeStamp() << "] Login successfully." << ENDL;
 #else
-    std::cout << "["<< input.TimeStamp() << "] 0" << ENDL;
+    output << "["<< input.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
 }
 
 void UserManage::Logout(ParameterTable& input) {
-    if (!loginPool_.Contains(input['u'])) {
+    SessionId session = loginPool_.Find(input['u']);
+    if (session == kNoSession) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Logout failed: user "
-                  << input['u'] << " hasn't logged in yet." << std::endl;
+        output << "[" << input.TimeStamp() << "] Logout failed: user "
+                  << input['u'] << " hasn't logged in yet." << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
-    loginPool_.Logout(static_cast<FixedString<20>>(input['u']));
+    WriteBack_(loginPool_[session]);
+    loginPool_.Logout(session);
 #ifdef PRETTY_PRINT
-    std::cout << "[" << input.TimeStamp() << "] Logout successfully." << std::endl;
+    output << "[" << input.TimeStamp() << "] Logout successfully." << ENDL;
 #else
-    std::cout << "["<< input.TimeStamp() << "] 0" << ENDL;
+    output << "["<< input.TimeStamp() << "] 0" << ENDL;
 #endif // PRETTY_PRINT
 }
 
 void UserManage::Query(ParameterTable& input) {
-    if (!loginPool_.Contains(input['c'])) {
+    SessionId operatorSession = loginPool_.Find(input['c']);
+    if (operatorSession == kNoSession) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Query failed: user "
-                  << input['c'] << " hasn't logged in yet." << std::endl;
+        output << "[" << input.TimeStamp() << "] Query failed: user "
+                  << input['c'] << " hasn't logged in yet." << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
-    if (!userIndex_.Contains(ToHashPair(input['u']))) {
+    PhaseTimer timer(Phase::index);
+    long position;
+    if (!userIndex_.Contains(ToHashPair(input['u']), position)) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Query failed: target user "
-                  << input['u'] << " doesn't exist." << std::endl;
+        output << "[" << input.TimeStamp() << "] Query failed: target user "
+                  << input['u'] << " doesn't exist." << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
-    long position = userIndex_.Find();
+    timer.Switch(Phase::fetch);
     User user = userData_.Get(position);
-    const User& operationUser = loginPool_.GetData(input['c']);
+    timer.Switch(Phase::compute);
+    VERIFY_HASH_HIT("user_index", user.userName == input['u']);
+    const User& operationUser = loginPool_[operatorSession].user;
 
     if (user.privilege > operationUser.privilege ||
        (user.privilege == operationUser.privilege &&
        input['c'] != input['u'])) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp()
-                  << "] Query failed: unauthorized operation." << std::endl;
+        output << "[" << input.TimeStamp()
+                  << "] Query failed: unauthorized operation." << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
-    std::cout << "[" << input.TimeStamp() << "] "
+    timer.Switch(Phase::output);
+    output << "[" << input.TimeStamp() << "] "
               << user.userName << " " << user.name << " "
               << user.mailAddress << " " << user.privilege << ENDL;
 }
 
 void UserManage::Modify(ParameterTable& input) {
-    if (!loginPool_.Contains(input['c'])) {
+    SessionId operatorSession = loginPool_.Find(input['c']);
+    if (operatorSession == kNoSession) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Modify failed: user "
-                  << input['c'] << " hasn't logged in yet." << std::endl;
+        output << "[" << input.TimeStamp() << "] Modify failed: user "
+                  << input['c'] << " hasn't logged in yet." << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
+    PhaseTimer timer(Phase::index);
     if (!userIndex_.Contains(ToHashPair(input['u']))) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp() << "] Modify failed: target user "
-                  << input['u'] << " doesn't exist." << std::endl;
+        output << "[" << input.TimeStamp() << "] Modify failed: target user "
+                  << input['u'] << " doesn't exist." << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
     long position = userIndex_.Find();
+    timer.Switch(Phase::fetch);
     User user = userData_.Get(position);
-    const User& operationUser = loginPool_.GetData(input['c']);
+    timer.Switch(Phase::compute);
+    VERIFY_HASH_HIT("user_index", user.userName == input['u']);
+    const User& operationUser = loginPool_[operatorSession].user;
 
     if (user.privilege > operationUser.privilege ||
         (user.privilege == operationUser.privilege &&
          input['c'] != input['u'])) {
 #ifdef PRETTY_PRINT
-        std::cout << "[" << input.TimeStamp()
-                  << "] Modify failed: unauthorized operation." << std::endl;
+        output << "[" << input.TimeStamp()
+                  << "] Modify failed: unauthorized operation." << ENDL;
 #else
-        std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+        output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
         return;
     }
 
     if (!input['g'].empty()) {
-        int privilege = StringToInt(input['g']);
+        int privilege = input.GetInt('g');
 #ifdef GUI
         if (privilege > operationUser.privilege) {
 #else
         if (privilege >= operationUser.privilege) {
 #endif // GUI
 #ifdef PRETTY_PRINT
-            std::cout << "[" << input.TimeStamp()
+            output << "[" << input.TimeStamp()
                       << "] Modify failed: privilege is higher than operating user."
-                      << std::endl;
+                      << ENDL;
 #else
-            std::cout << "["<< input.TimeStamp() << "] -1" << ENDL;
+            output << "["<< input.TimeStamp() << "] -1" << ENDL;
 #endif // PRETTY_PRINT
             return;
         }
@@ -301,46 +340,64 @@ void UserManage::Modify(ParameterTable& input) {
         user.mailAddress = input['m'];
     }
 
+    // The order count on disk may be behind the one of the session.
+    SessionId session = loginPool_.Find(input['u']);
+    if (session != kNoSession) {
+        user.orderCount = loginPool_[session].user.orderCount;
+        loginPool_[session].user = user;
+        loginPool_[session].dirty = false;
+    }
+    timer.Switch(Phase::fetch);
 #ifdef ROLLBACK
     userData_.Modify(position, user, input.TimeStamp());
 #else
     userData_.Modify(position, user);
 #endif // ROLLBACK
-    if (loginPool_.Contains(input['u'])) {
-        loginPool_.ModifyProfile(user);
-    }
 
-    std::cout << "["<< input.TimeStamp() << "] "
+    timer.Switch(Phase::output);
+    output << "["<< input.TimeStamp() << "] "
               << user.userName << " " << user.name << " "
               << user.mailAddress << " " << user.privilege << ENDL;
 }
 
-long UserManage::AddOrder(const std::string& name, Ticket& ticket,
+long UserManage::AddOrder(SessionId session, Ticket& ticket,
                           long timeStamp, TrainManage& trainManage) {
-    if (!userIndex_.Contains(ToHashPair(name))) {
-        return -1;
-    }
-    long position = userIndex_.Find();
-    User user = userData_.Get(position);
-    ticket.last = user.orderInfo;
-    user.orderInfo = trainManage.AddOrder(ticket, timeStamp);
+    Session& current = loginPool_[session];
+    User& user = current.user;
+    ++user.orderCount;
+    long orderPosition = trainManage.AddOrder(ticket, OrderKey(current.userHash, user.orderCount),
+                                              timeStamp);
 #ifdef ROLLBACK
-    userData_.Modify(position, user, timeStamp);
+    // A rollback restores user_data as it was at some time stamp, so the
+    // count has to be there at every time stamp.
+    userData_.Modify(current.position, user, timeStamp);
 #else
-    userData_.Modify(position, user);
+    current.dirty = true;
 #endif // ROLLBACK
-    if (loginPool_.Contains(name)) {
-        loginPool_.ModifyProfile(user);
+    return orderPosition;
+}
+
+void UserManage::Checkpoint() {
+    for (SessionId id = 0; id < loginPool_.SlotCount(); ++id) {
+        WriteBack_(loginPool_[id]);
     }
-    return user.orderInfo;
 }
 
-bool UserManage::Logged(const std::string& name) {
-    return loginPool_.Contains(name);
+void UserManage::WriteBack_(Session& session) {
+#ifndef ROLLBACK
+    if (session.dirty) {
+        userData_.Modify(session.position, session.user);
+        session.dirty = false;
+    }
+#endif // ROLLBACK
 }
 
-const User& UserManage::GetUser(const std::string& name) {
-    return loginPool_.GetData(name);
+SessionId UserManage::FindSession(std::string_view name) {
+    return loginPool_.Find(name);
+}
+
+const Session& UserManage::GetSession(SessionId session) {
+    return loginPool_[session];
 }
 
 void UserManage::Clear() {
@@ -349,6 +406,18 @@ void UserManage::Clear() {
     loginPool_.Clear();
 }
 
+void UserManage::WarmUp(bool preload) {
+    userIndex_.WarmUp(preload);
+    userData_.WarmUp(preload);
+}
+
+#ifndef ROLLBACK
+void UserManage::Compact() {
+    userIndex_.Compact();
+    userData_.Trim();
+}
+#endif // ROLLBACK
+
 #ifdef ROLLBACK
 void UserManage::RollBack(long timeStamp) {
     loginPool_.Clear();
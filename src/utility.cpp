@@ -20,7 +20,7 @@
 #include "user_manage.h"
 
 
-int StringToInt(const std::string& string) {
+int StringToInt(std::string_view string) {
     int result = 0;
     for (char i : string) {
         result = result * 10 + i - '0';
@@ -28,8 +28,3 @@ int StringToInt(const std::string& string) {
     return result;
 }
 
-
-HashPair ToHashPair(const std::string& string) {
-    return HashPair(FixedStringHash1()(string),
-                    FixedStringHash2()(string));
-}
@@ -0,0 +1,77 @@
+// Train Ticket System
+// Copyright (C) 2022 Lau Yee-Yu & relyt871
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "worker_pool.h"
+
+#ifdef CONCURRENT
+
+WorkerPool::WorkerPool(int count) {
+    for (int i = 1; i < count; ++i) {
+        threads_.PushBack(new std::thread(&WorkerPool::Work_, this));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+    for (auto& thread : threads_) {
+        thread->join();
+        delete thread;
+    }
+}
+
+void WorkerPool::Run(long count, const std::function<void(long)>& task) {
+    if (count == 0) return;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        task_ = &task;
+        count_ = count;
+        next_.store(0, std::memory_order_relaxed);
+        busy_ = static_cast<long>(threads_.Size());
+        ++round_;
+    }
+    start_.notify_all();
+    Drain_();
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+    task_ = nullptr;
+}
+
+void WorkerPool::Work_() {
+    long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [this, seen] { return stopping_ || round_ != seen; });
+            if (stopping_) return;
+            seen = round_;
+        }
+        Drain_();
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (--busy_ == 0) done_.notify_one();
+    }
+}
+
+void WorkerPool::Drain_() {
+    for (long i = next_.fetch_add(1); i < count_; i = next_.fetch_add(1)) {
+        (*task_)(i);
+    }
+}
+
+#endif // CONCURRENT